@@ -0,0 +1,143 @@
+#include "BurstMonitor.h"
+using namespace CNNS;
+
+#include <TH1D.h>
+
+#include <cmath>
+#include <istream>
+
+ClassImp(BurstMonitor)
+
+//______________________________________________________________________________
+//
+
+BurstMonitor::BurstMonitor(const TH1D *rate, Double_t background,
+      Double_t window, Int_t nsub, Int_t capacity) :
+   TNamed(Form("%sMonitor",rate->GetName()), rate->GetTitle()),
+   Threshold(10), fWindow(window), fBackground(background),
+   fNsub(nsub<1?1:nsub), fSignal(0), fWeight(nsub<1?1:nsub),
+   fTimes(capacity), fHead(0), fBound(nsub<1?1:nsub), fSum(0),
+   fArmed(kTRUE), fNoverflow(0)
+{
+   if (nsub<1) {
+      Warning("BurstMonitor","Number of sub-windows must be positive!");
+      Warning("BurstMonitor","Use 1 instead of %d.", nsub);
+   }
+   if (fBackground<=0) {
+      Warning("BurstMonitor","Background rate must be positive!");
+      Warning("BurstMonitor","Use 1e-3 Hz instead of %f Hz.", background);
+      fBackground=1e-3;
+   }
+
+   // expected burst events in each sub-window from the rate curve
+   const TAxis *axis = rate->GetXaxis();
+   Double_t start = axis->GetBinLowEdge(1), dt = fWindow/fNsub;
+   for (Int_t k=0; k<fNsub; k++) {
+      Double_t low = start+k*dt, up = low+dt, s=0;
+      for (Int_t i=1; i<=axis->GetNbins(); i++) {
+         Double_t a = axis->GetBinLowEdge(i), b = axis->GetBinUpEdge(i);
+         if (b<=low) continue;
+         if (a>=up) break;
+         s += rate->GetBinContent(i)*((b<up?b:up)-(a>low?a:low));
+      }
+      fWeight[k] = std::log(1+s/(fBackground*dt));
+      fSignal += s;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void BurstMonitor::Reset()
+{
+   fHead=0;
+   for (Int_t k=0; k<fNsub; k++) fBound[k]=0;
+   fSum=0;
+   fArmed=kTRUE;
+   fNoverflow=0;
+}
+
+//______________________________________________________________________________
+//
+
+void BurstMonitor::Drop()
+{
+   // the oldest event is in the last sub-window starting at it
+   Long64_t oldest = fBound[0];
+   Int_t k=0;
+   while (k+1<fNsub && fBound[k+1]==oldest) k++;
+   fSum -= fWeight[k];
+   for (Int_t j=0; j<=k; j++) fBound[j]=oldest+1;
+   fNoverflow++;
+}
+
+//______________________________________________________________________________
+//
+
+void BurstMonitor::Resum()
+{
+   fSum=0;
+   for (Int_t k=0; k<fNsub; k++) {
+      Long64_t next = k+1<fNsub ? fBound[k+1] : fHead;
+      fSum += fWeight[k]*(next-fBound[k]);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void BurstMonitor::Advance(Double_t now)
+{
+   // later boundaries first, so an event crossing several of them moves
+   // down one sub-window at a time
+   Long64_t capacity = fTimes.size();
+   Double_t dt = fWindow/fNsub;
+   for (Int_t k=fNsub-1; k>=0; k--) {
+      Double_t boundary = now-fWindow+k*dt;
+      Double_t moved = k>0 ? fWeight[k-1]-fWeight[k] : -fWeight[k];
+      while (fBound[k]<fHead && fTimes[fBound[k]%capacity]<boundary) {
+         fSum += moved;
+         fBound[k]++;
+      }
+   }
+   if (!fArmed && LLR()<Threshold) fArmed=kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t BurstMonitor::Fill(Double_t time)
+{
+   Advance(time);
+   Long64_t capacity = fTimes.size();
+   if (fHead-fBound[0]>=capacity) Drop();
+   fTimes[fHead%capacity] = time;
+   fHead++;
+   if (fHead%capacity==0) Resum(); // once per wrap of the buffer
+   else fSum += fWeight[fNsub-1];
+
+   if (!fArmed || LLR()<Threshold) return kFALSE;
+   fArmed=kFALSE;
+   Trigger trigger;
+   trigger.Time = time;
+   trigger.LLR = LLR();
+   trigger.Nevt = Nevt();
+   if (fHandler) fHandler(trigger);
+   else Info("Fill","Trigger at %.6f s, LLR=%.2f, %lld events in window",
+         trigger.Time, trigger.LLR, trigger.Nevt);
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t BurstMonitor::Process(std::istream &in)
+{
+   Long64_t n=0;
+   Double_t time;
+   while (in>>time) {
+      Fill(time);
+      n++;
+   }
+   return n;
+}
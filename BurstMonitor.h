@@ -0,0 +1,100 @@
+#ifndef CNNS_BURSTMONITOR_H
+#define CNNS_BURSTMONITOR_H
+
+#include <TNamed.h>
+
+#include <vector>
+#include <iosfwd>
+#include <functional>
+
+class TH1D;
+
+namespace CNNS { class BurstMonitor; }
+
+/**
+ * Online search for a supernova burst in a stream of event times. The
+ * last Window seconds are split into sub-windows, each compared to the
+ * expected number of events of a burst that started at the beginning of
+ * the window, taken from a rate curve such as
+ * SupernovaExperiment::HNevtT(type, kTRUE), and to the background. The
+ * log-likelihood ratio
+ *
+ *    LLR = sum_k n_k ln(1+s_k/b_k) - sum_k s_k
+ *
+ * is updated as events enter the window and move between sub-windows.
+ * Every event crosses each sub-window boundary once, so an update costs
+ * O(1) for a fixed number of sub-windows. Event times are kept in a ring
+ * buffer allocated once. The LLR is summed again from the number of events
+ * in each sub-window whenever the buffer wraps around, so that rounding
+ * errors of the updates do not pile up in long runs.
+ */
+class CNNS::BurstMonitor : public TNamed
+{
+   public:
+      struct Trigger {
+         Double_t Time; // time of the event that fired [second]
+         Double_t LLR; // log-likelihood ratio at that time
+         Long64_t Nevt; // number of events in the window
+      };
+      typedef std::function<void(const Trigger &trigger)> Handler;
+
+      Double_t Threshold; // LLR above which a trigger is issued
+
+   protected:
+      Double_t fWindow; // length of the sliding window [second]
+      Double_t fBackground; // background rate [Hz]
+      Int_t fNsub; // number of sub-windows
+      Double_t fSignal; // expected burst events in the window
+      std::vector<Double_t> fWeight; // ln(1+s_k/b_k) of sub-window k
+
+      std::vector<Double_t> fTimes; //! ring buffer of event times
+      Long64_t fHead; //! number of events ever filled
+      std::vector<Long64_t> fBound; //! first event after sub-window start
+      Double_t fSum; //! sum of weights of events in the window
+      Bool_t fArmed; //! a trigger is issued only if armed
+      Long64_t fNoverflow; //! events dropped from a full buffer
+      Handler fHandler; //! called for each trigger
+
+      void Drop(); // remove the oldest event from a full buffer
+      void Resum(); // fSum from the events in each sub-window
+
+   public:
+      BurstMonitor() : TNamed(), Threshold(0), fWindow(0), fBackground(0),
+      fNsub(0), fSignal(0), fHead(0), fSum(0), fArmed(kTRUE),
+      fNoverflow(0) {};
+      /**
+       * rate: expected burst rate [Hz] versus time [second], the burst
+       * starts at its first bin. background: rate [Hz] without a burst.
+       * capacity: maximal number of events kept in the window.
+       */
+      BurstMonitor(const TH1D *rate, Double_t background, Double_t window=1,
+            Int_t nsub=10, Int_t capacity=1<<16);
+      virtual ~BurstMonitor() {};
+
+      void SetHandler(Handler handler) { fHandler = handler; }
+      void Reset(); // forget all events
+
+      /**
+       * Add an event at time [second], times must not decrease. Return
+       * kTRUE if it issues a trigger.
+       */
+      Bool_t Fill(Double_t time);
+      /**
+       * Slide the window to now without a new event.
+       */
+      void Advance(Double_t now);
+      /**
+       * Fill times read from in, one per line. Return the number of events.
+       */
+      Long64_t Process(std::istream &in);
+
+      Double_t LLR() const { return fSum-fSignal; }
+      Long64_t Nevt() const { return fHead-fBound[0]; } // in window
+      Double_t ExpectedSignal() const { return fSignal; }
+      Double_t ExpectedBackground() const { return fBackground*fWindow; }
+      Long64_t Noverflow() const { return fNoverflow; }
+
+      ClassDef(BurstMonitor,1);
+};
+
+#endif
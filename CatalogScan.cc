@@ -0,0 +1,388 @@
+#include "Detector.h"
+#include "CatalogScan.h"
+#include "SupernovaExperiment.h"
+#include "FluxTable.h"
+#include "ResultCache.h"
+using namespace CNNS;
+
+#include <NEUS/NakazatoModel.h>
+using namespace NEUS;
+
+#include <TH1D.h>
+#include <TROOT.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TError.h>
+#include <TSystem.h>
+
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+ClassImp(CatalogScan)
+
+//______________________________________________________________________________
+//
+
+CatalogScan::CatalogScan(const char *dataDir) :
+   TNamed("catalogScan","scan of supernova models"),
+   DataDir(dataDir), Distance(10*kpc), Nthreads(1), Shard(0), Nshards(1),
+   fNdetectors(0)
+{
+}
+
+//______________________________________________________________________________
+//
+
+void CatalogScan::AddModel(Double_t mass, Double_t metallicity,
+      Double_t revival)
+{
+   Model model;
+   model.Mass = mass;
+   model.Metallicity = metallicity;
+   model.Revival = revival;
+   fModels.push_back(model);
+}
+
+//______________________________________________________________________________
+//
+
+void CatalogScan::AddNakazatoCatalog()
+{
+   const Double_t mass[4] = {13, 20, 30, 50};
+   const Double_t metallicity[2] = {0.02, 0.004};
+   const Double_t revival[3] = {100, 200, 300};
+   for (Int_t z=0; z<2; z++)
+      for (Int_t m=0; m<4; m++)
+         for (Int_t t=0; t<3; t++)
+            AddModel(mass[m], metallicity[z], revival[t]);
+   AddModel(30, 0.004, 0); // black hole
+}
+
+//______________________________________________________________________________
+//
+
+TString CatalogScan::FluxFile(const char *dir, const Model &model)
+{
+   return Form("%s/nakazato-%g-%g-%g.flux", dir, model.Mass,
+         model.Metallicity, model.Revival);
+}
+
+//______________________________________________________________________________
+//
+
+void CatalogScan::Process(Int_t i, std::vector<Detector*> &detectors,
+      std::vector<SupernovaExperiment*> &exps,
+      std::vector<Summary> &summaries)
+{
+   const Model &m = fModels[i];
+   NakazatoModel *model = 0;
+   FluxTable *table = 0;
+   TString file = FluxFile(FluxDir, m);
+   if (!FluxDir.IsNull() && !gSystem->AccessPathName(file)) {
+      table = new FluxTable(file);
+      if (table->IsZombie()) {
+         delete table;
+         table = 0;
+      }
+   }
+   if (!table) {
+      model = new NakazatoModel(m.Mass, m.Metallicity, m.Revival);
+      model->LoadData(DataDir.Data());
+   }
+
+   std::vector<Double_t> distances(fDistances);
+   if (distances.empty()) distances.push_back(Distance);
+   Int_t nthr = fThresholds.empty() ? 1 : fThresholds.size();
+
+   summaries.clear();
+   for (size_t d=0; d<exps.size(); d++) {
+      SupernovaExperiment *exp = exps[d];
+      Detector *detector = detectors[d];
+      Double_t threshold = detector->EnergyThreshold;
+      if (table) exp->SetFluxTable(table);
+      else exp->SetSupernovaModel(model);
+
+      // integrals are done once, other grid points only rescale them
+      for (size_t k=0; k<distances.size(); k++) {
+         exp->Distance = distances[k];
+         for (Int_t j=0; j<nthr; j++) {
+            if (!fThresholds.empty()) detector->EnergyThreshold=fThresholds[j];
+
+            Summary s;
+            s.Index = i;
+            s.Detector = d;
+            s.IDistance = k;
+            s.IThreshold = fThresholds.empty() ? -1 : j;
+            s.Distance = distances[k]/kpc;
+            s.Threshold = detector->EnergyThreshold/keV;
+            s.Nevt = exp->Nevt(0, 0);
+            s.NevtThr = exp->Nevt();
+            TH1D *h = exp->HNevtT(0, kTRUE);
+            Int_t nt = h->GetNbinsX();
+            s.Tbins.resize(nt+1);
+            s.NevtT.resize(nt);
+            s.Ndetectable = 0;
+            for (Int_t it=1; it<=nt; it++) {
+               s.Tbins[it-1] = h->GetXaxis()->GetBinLowEdge(it);
+               s.NevtT[it-1] = h->GetBinContent(it)*h->GetBinWidth(it);
+               s.Ndetectable += s.NevtT[it-1];
+            }
+            s.Tbins[nt] = h->GetXaxis()->GetBinUpEdge(nt);
+            summaries.push_back(s);
+         }
+      }
+
+      // release histograms and tabulated fluxes of this model
+      detector->EnergyThreshold = threshold;
+      exp->SetSupernovaModel(0);
+   }
+   if (model) delete model;
+   if (table) delete table;
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t CatalogScan::SameGrid(const CatalogScan *other) const
+{
+   if (other->fNdetectors!=fNdetectors || other->Nshards!=Nshards) return kFALSE;
+   if (other->fModels.size()!=fModels.size()) return kFALSE;
+   for (size_t i=0; i<fModels.size(); i++)
+      if (other->fModels[i].Mass!=fModels[i].Mass
+            || other->fModels[i].Metallicity!=fModels[i].Metallicity
+            || other->fModels[i].Revival!=fModels[i].Revival) return kFALSE;
+   if (fDistances.empty() && other->Distance!=Distance) return kFALSE;
+   return other->fDistances==fDistances && other->fThresholds==fThresholds;
+}
+
+//______________________________________________________________________________
+//
+
+namespace {
+   // branches of the output tree, shared by CatalogScan::Run and Merge
+   struct Row {
+      CNNS::CatalogScan::Summary summary;
+      CNNS::CatalogScan::Model model;
+      std::vector<Double_t> *tbins, *nevtT;
+      Row() : tbins(&summary.Tbins), nevtT(&summary.NevtT) {}
+   };
+
+   TTree* Book(Row &row)
+   {
+      TTree *tree = new TTree("catalog", "scan of supernova models");
+      tree->Branch("index", &row.summary.Index, "index/I");
+      tree->Branch("mass", &row.model.Mass, "mass/D");
+      tree->Branch("metallicity", &row.model.Metallicity, "metallicity/D");
+      tree->Branch("revival", &row.model.Revival, "revival/D");
+      tree->Branch("detector", &row.summary.Detector, "detector/I");
+      tree->Branch("idistance", &row.summary.IDistance, "idistance/I");
+      tree->Branch("ithreshold", &row.summary.IThreshold, "ithreshold/I");
+      tree->Branch("distance", &row.summary.Distance, "distance/D");
+      tree->Branch("threshold", &row.summary.Threshold, "threshold/D");
+      tree->Branch("nevt", &row.summary.Nevt, "nevt/D");
+      tree->Branch("nevtThr", &row.summary.NevtThr, "nevtThr/D");
+      tree->Branch("ndetectable", &row.summary.Ndetectable, "ndetectable/D");
+      tree->Branch("tbins", &row.tbins);
+      tree->Branch("nevtT", &row.nevtT);
+      return tree;
+   }
+
+   void Attach(TTree *tree, Row &row)
+   {
+      tree->SetBranchAddress("index", &row.summary.Index);
+      tree->SetBranchAddress("mass", &row.model.Mass);
+      tree->SetBranchAddress("metallicity", &row.model.Metallicity);
+      tree->SetBranchAddress("revival", &row.model.Revival);
+      tree->SetBranchAddress("detector", &row.summary.Detector);
+      tree->SetBranchAddress("idistance", &row.summary.IDistance);
+      tree->SetBranchAddress("ithreshold", &row.summary.IThreshold);
+      tree->SetBranchAddress("distance", &row.summary.Distance);
+      tree->SetBranchAddress("threshold", &row.summary.Threshold);
+      tree->SetBranchAddress("nevt", &row.summary.Nevt);
+      tree->SetBranchAddress("nevtThr", &row.summary.NevtThr);
+      tree->SetBranchAddress("ndetectable", &row.summary.Ndetectable);
+      tree->SetBranchAddress("tbins", &row.tbins);
+      tree->SetBranchAddress("nevtT", &row.nevtT);
+   }
+
+   // order of entries in merged files
+   bool Before(const CNNS::CatalogScan::Summary &a,
+         const CNNS::CatalogScan::Summary &b)
+   {
+      if (a.Index!=b.Index) return a.Index<b.Index;
+      if (a.Detector!=b.Detector) return a.Detector<b.Detector;
+      if (a.IDistance!=b.IDistance) return a.IDistance<b.IDistance;
+      return a.IThreshold<b.IThreshold;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t CatalogScan::Run(const char *output)
+{
+   if (fDetectors.empty() || fModels.empty()) {
+      Warning("Run","No detector or no model to scan!");
+      return 0;
+   }
+   if (Nshards<1 || Shard<0 || Shard>=Nshards) {
+      Warning("Run","Shard %d is not in [0, %d)!", Shard, Nshards);
+      return 0;
+   }
+   TFile *file = new TFile(output, "recreate");
+   if (file->IsZombie()) {
+      Warning("Run","Cannot create %s!", output);
+      delete file;
+      return 0;
+   }
+   fNdetectors = fDetectors.size();
+
+   // models of this shard
+   std::vector<Int_t> models;
+   for (Int_t i=Shard; i<Nmodels(); i+=Nshards) models.push_back(i);
+   Int_t nmodels = models.size();
+
+   // branches are filled from one summary at a time
+   Row row;
+   TTree *tree = Book(row);
+
+   UInt_t nthreads = Nthreads<1 ? 1 : Nthreads;
+   if (nthreads>models.size()) nthreads=models.size();
+   // even a single worker runs next to tree->Fill() of this thread
+   if (nthreads>0) ROOT::EnableThreadSafety();
+
+   // workers take models in turn and queue their summaries
+   std::atomic<Int_t> next(0);
+   std::mutex mutex;
+   std::condition_variable ready;
+   std::deque<Summary> queue;
+   UInt_t nrunning = nthreads;
+   std::vector<std::thread> workers;
+   for (UInt_t w=0; w<nthreads; w++) {
+      workers.push_back(std::thread([&]() {
+         std::vector<Detector*> detectors;
+         std::vector<SupernovaExperiment*> exps;
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t d=0; d<fDetectors.size(); d++) {
+               detectors.push_back((Detector*) fDetectors[d]->Clone());
+               exps.push_back(new SupernovaExperiment(detectors[d]));
+               exps.back()->Results()->SetBudget(0); // no model comes back
+            }
+         }
+         std::vector<Summary> summaries;
+         for (Int_t i=next++; i<nmodels; i=next++) {
+            Process(models[i], detectors, exps, summaries);
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t d=0; d<summaries.size(); d++)
+               queue.push_back(summaries[d]);
+            ready.notify_one();
+         }
+         std::lock_guard<std::mutex> lock(mutex);
+         for (size_t d=0; d<exps.size(); d++) {
+            delete exps[d];
+            delete detectors[d];
+         }
+         nrunning--;
+         ready.notify_one();
+      }));
+   }
+
+   // write summaries as they come
+   Long64_t nrows=0;
+   std::unique_lock<std::mutex> lock(mutex);
+   while (nrunning>0 || !queue.empty()) {
+      if (queue.empty()) {
+         ready.wait(lock);
+         continue;
+      }
+      row.summary = queue.front();
+      queue.pop_front();
+      lock.unlock();
+      row.model = fModels[row.summary.Index];
+      tree->Fill();
+      nrows++;
+      lock.lock();
+   }
+   lock.unlock();
+   for (UInt_t w=0; w<nthreads; w++) workers[w].join();
+
+   file->cd();
+   tree->Write();
+   Write("catalogScan");
+   delete file;
+   return nrows;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t CatalogScan::Merge(const char *output,
+      const std::vector<TString> &inputs)
+{
+   CatalogScan *grid=0;
+   std::vector<Int_t> done;
+   std::vector<Summary> summaries;
+   Row row;
+   for (size_t f=0; f<inputs.size(); f++) {
+      TFile file(inputs[f].Data());
+      CatalogScan *scan = (CatalogScan*) file.Get("catalogScan");
+      TTree *tree = (TTree*) file.Get("catalog");
+      if (!scan || !tree) {
+         ::Warning("CatalogScan::Merge","No scan in %s!", inputs[f].Data());
+         delete grid;
+         return -1;
+      }
+      Int_t shard = scan->Shard;
+      if (!grid) {
+         grid = scan;
+         done.assign(grid->Nshards, 0);
+      } else {
+         Bool_t same = grid->SameGrid(scan);
+         delete scan;
+         if (!same) {
+            ::Warning("CatalogScan::Merge","%s scans another grid!",
+                  inputs[f].Data());
+            delete grid;
+            return -1;
+         }
+      }
+      if (shard<0 || shard>=grid->Nshards || done[shard]++) {
+         ::Warning("CatalogScan::Merge","Shard %d of %s is not expected!",
+               shard, inputs[f].Data());
+         delete grid;
+         return -1;
+      }
+      Attach(tree, row);
+      for (Long64_t i=0; i<tree->GetEntries(); i++) {
+         tree->GetEntry(i);
+         summaries.push_back(row.summary);
+      }
+   }
+   if (!grid) return -1;
+   for (size_t i=0; i<done.size(); i++) {
+      if (done[i]) continue;
+      ::Warning("CatalogScan::Merge","Shard %d is missing!", Int_t(i));
+      delete grid;
+      return -1;
+   }
+   std::sort(summaries.begin(), summaries.end(), Before);
+
+   TFile file(output, "recreate");
+   TTree *tree = Book(row);
+   for (size_t i=0; i<summaries.size(); i++) {
+      row.summary = summaries[i];
+      row.model = grid->fModels[row.summary.Index];
+      tree->Fill();
+   }
+   tree->Write();
+   grid->Shard = 0;
+   grid->Nshards = 1;
+   grid->Write("catalogScan");
+   delete grid;
+   return summaries.size();
+}
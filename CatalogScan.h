@@ -0,0 +1,127 @@
+#ifndef CNNS_CATALOGSCAN_H
+#define CNNS_CATALOGSCAN_H
+
+#include <TNamed.h>
+#include <TString.h>
+
+#include <vector>
+
+namespace CNNS {
+   class CatalogScan;
+   class Detector;
+   class SupernovaExperiment;
+}
+
+/**
+ * Run models of the Nakazato catalog against several detectors, distances
+ * and thresholds on a pool of threads. Each worker loads one model at a
+ * time, evaluates it on the whole grid and deletes it before taking the
+ * next one, so memory does not grow with the size of the catalog.
+ * Summaries are written by the calling thread to a TTree while workers go
+ * on. A scan can be split into shards run by independent processes, whose
+ * outputs are combined by Merge.
+ */
+class CNNS::CatalogScan : public TNamed
+{
+   public:
+      /**
+       * Parameters of a Nakazato model, revival time 0 is a black hole.
+       */
+      struct Model {
+         Double_t Mass; // progenitor mass in solar mass
+         Double_t Metallicity;
+         Double_t Revival; // shock revival time in ms
+      };
+      /**
+       * Result of one model for one detector, distance and threshold.
+       */
+      struct Summary {
+         Int_t Index; // index of the model
+         Int_t Detector; // index of the detector
+         Int_t IDistance; // index of the distance
+         Int_t IThreshold; // index of the threshold, -1 for detector's own
+         Double_t Distance; // [kpc]
+         Double_t Threshold; // [keV]
+         Double_t Nevt; // events of all recoil energies
+         Double_t NevtThr; // events above threshold
+         Double_t Ndetectable; // events above threshold times efficiency
+         std::vector<Double_t> Tbins; // edges of time bins [second]
+         std::vector<Double_t> NevtT; // detectable events in time bins
+      };
+
+      TString DataDir; // directory given to NakazatoModel::LoadData
+      /**
+       * Directory of flux tables written by ConvertFlux.exe. Models with a
+       * table in it are mapped from the table instead of being loaded from
+       * DataDir. Tables are not used if it is empty (default).
+       */
+      TString FluxDir;
+      Double_t Distance; // used if no distance is added
+      UInt_t Nthreads; // number of workers
+      Int_t Shard; // this process runs models with index%Nshards==Shard
+      Int_t Nshards; // number of independent processes
+
+   protected:
+      std::vector<Model> fModels;
+      std::vector<Double_t> fDistances;
+      std::vector<Double_t> fThresholds;
+      Int_t fNdetectors; // number of detectors in the output
+      std::vector<Detector*> fDetectors; //! not owned
+
+      /**
+       * Load model i, evaluate it on the grid with detectors and
+       * experiments owned by the calling worker and delete it.
+       */
+      void Process(Int_t i, std::vector<Detector*> &detectors,
+            std::vector<SupernovaExperiment*> &exps,
+            std::vector<Summary> &summaries);
+      /**
+       * Return kTRUE if other scans the same grid.
+       */
+      Bool_t SameGrid(const CatalogScan *other) const;
+
+   public:
+      CatalogScan(const char *dataDir="../neus");
+      virtual ~CatalogScan() {};
+
+      void AddDetector(Detector *detector) { fDetectors.push_back(detector); }
+      void AddModel(Double_t mass, Double_t metallicity, Double_t revival);
+      /**
+       * Add progenitor masses 13, 20, 30, 50 with metallicities 0.02,
+       * 0.004 and revival times 100, 200, 300 ms, and the black hole.
+       */
+      void AddNakazatoCatalog();
+      void AddDistance(Double_t distance) { fDistances.push_back(distance); }
+      /**
+       * Energy thresholds replacing that of each detector in turn. Only
+       * the thresholds of the detectors are used if none is added.
+       */
+      void AddThreshold(Double_t threshold) { fThresholds.push_back(threshold); }
+      Int_t Nmodels() const { return fModels.size(); }
+      /**
+       * Name of the flux table of a model in directory dir.
+       */
+      static TString FluxFile(const char *dir, const Model &model);
+      const Model& GetModel(Int_t i) const { return fModels[i]; }
+
+      /**
+       * Scan all models of this shard, write a TTree "catalog" and this
+       * object to output. Each worker evaluates clones of the detectors,
+       * so detectors need not be thread-safe. Return the number of
+       * summaries written.
+       */
+      Long64_t Run(const char *output);
+      /**
+       * Combine outputs of Run into one file with entries sorted by model,
+       * detector, distance and threshold. All shards of the same grid must
+       * be given once. Merging the output of a single process run gives the
+       * same file as merging its shards. Return the number of entries, -1
+       * on error.
+       */
+      static Long64_t Merge(const char *output,
+            const std::vector<TString> &inputs);
+
+      ClassDef(CatalogScan,3);
+};
+
+#endif
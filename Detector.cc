@@ -1,3 +1,11 @@
 #include "Detector.h"
 using namespace CNNS;
 ClassImp(Detector)
+
+//______________________________________________________________________________
+//
+
+void Detector::Efficiencies(Int_t n, const Double_t *Enr, Double_t *efficiency)
+{
+   for (Int_t i=0; i<n; i++) efficiency[i] = Efficiency(Enr[i]);
+}
@@ -45,6 +45,12 @@ class CNNS::Detector : public TNamed
       virtual ~Detector() {};
 
       virtual Double_t Efficiency(Double_t Enr) { return 1.; }
+      /**
+       * Efficiencies at n recoil energies in one call. The default
+       * implementation calls Efficiency(Enr[i]) for each energy.
+       */
+      virtual void Efficiencies(Int_t n, const Double_t *Enr,
+            Double_t *efficiency);
 
       ClassDef(Detector,1);
 };
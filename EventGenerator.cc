@@ -0,0 +1,148 @@
+#include "Detector.h"
+#include "EventGenerator.h"
+using namespace CNNS;
+
+#include <TH2D.h>
+#include <TRandom3.h>
+
+#include <thread>
+
+ClassImp(EventGenerator)
+
+//______________________________________________________________________________
+//
+
+EventGenerator::EventGenerator(const TH2D *h, Detector *detector) :
+   TNamed(Form("%sGenerator",h->GetName()), h->GetTitle()),
+   fNt(h->GetNbinsX()), fNe(h->GetNbinsY()), fTotal(0)
+{
+   for (Int_t ix=1; ix<=fNt+1; ix++)
+      fTbins.push_back(h->GetXaxis()->GetBinLowEdge(ix));
+   for (Int_t iy=1; iy<=fNe+1; iy++)
+      fEbins.push_back(h->GetYaxis()->GetBinLowEdge(iy));
+
+   std::vector<Double_t> eff(fNe, 1.), Enr(fNe);
+   if (detector) {
+      for (Int_t iy=1; iy<=fNe; iy++)
+         Enr[iy-1] = h->GetYaxis()->GetBinCenter(iy)*keV;
+      detector->Efficiencies(fNe, Enr.data(), eff.data());
+   }
+
+   // expected events in each bin, cell i = (iy-1)*fNt + ix-1
+   Int_t n = fNt*fNe;
+   std::vector<Double_t> w(n);
+   for (Int_t iy=1; iy<=fNe; iy++) {
+      Double_t de = h->GetYaxis()->GetBinWidth(iy);
+      for (Int_t ix=1; ix<=fNt; ix++) {
+         Double_t dt = h->GetXaxis()->GetBinWidth(ix);
+         Double_t nevt = h->GetBinContent(ix,iy)*dt*de*eff[iy-1];
+         w[(iy-1)*fNt+ix-1] = nevt>0 ? nevt : 0;
+         fTotal += w[(iy-1)*fNt+ix-1];
+      }
+   }
+   if (fTotal<=0) {
+      Warning("EventGenerator","No event expected in %s!",h->GetName());
+      return;
+   }
+
+   // Walker's alias table (Vose's construction)
+   fProb.resize(n);
+   fAlias.resize(n);
+   std::vector<Int_t> small, large;
+   for (Int_t i=0; i<n; i++) {
+      w[i] *= n/fTotal;
+      if (w[i]<1) small.push_back(i);
+      else large.push_back(i);
+   }
+   while (!small.empty() && !large.empty()) {
+      Int_t s = small.back(), l = large.back();
+      small.pop_back();
+      fProb[s] = w[s];
+      fAlias[s] = l;
+      w[l] -= 1-w[s];
+      if (w[l]<1) {
+         large.pop_back();
+         small.push_back(l);
+      }
+   }
+   // left-overs are 1 up to rounding errors
+   for (size_t i=0; i<large.size(); i++) {
+      fProb[large[i]] = 1;
+      fAlias[large[i]] = large[i];
+   }
+   for (size_t i=0; i<small.size(); i++) {
+      fProb[small[i]] = 1;
+      fAlias[small[i]] = small[i];
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void EventGenerator::Generate(TRandom &random, Int_t n, Double_t *time,
+      Double_t *Enr) const
+{
+   Int_t ncells = fProb.size();
+   if (ncells==0) {
+      if (n>0) Warning("Generate", "No bin to draw events from!");
+      return;
+   }
+   for (Int_t i=0; i<n; i++) {
+      Double_t u = random.Rndm()*ncells;
+      Int_t cell = static_cast<Int_t>(u);
+      if (cell>=ncells) cell=ncells-1;
+      if (u-cell>=fProb[cell]) cell = fAlias[cell];
+      Int_t it = cell%fNt, ie = cell/fNt;
+      time[i] = fTbins[it] + (fTbins[it+1]-fTbins[it])*random.Rndm();
+      Enr[i] = fEbins[ie] + (fEbins[ie+1]-fEbins[ie])*random.Rndm();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Int_t EventGenerator::Experiment(TRandom &random, std::vector<Double_t> &time,
+      std::vector<Double_t> &Enr) const
+{
+   Int_t n = fTotal>0 ? random.Poisson(fTotal) : 0;
+   time.resize(n);
+   Enr.resize(n);
+   if (n>0) Generate(random, n, time.data(), Enr.data());
+   return n;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t EventGenerator::Run(Long64_t nexperiments, Handler handler,
+      UInt_t nthreads, UInt_t seed) const
+{
+   if (nthreads<1) nthreads=1;
+   if (seed==0) {
+      Warning("Run","Seed 0 would seed TRandom3 from the clock!");
+      Warning("Run","Use 4357 instead.");
+      seed=4357;
+   }
+   std::vector<Long64_t> nevents(nthreads, 0);
+
+   // experiments are interleaved among threads, each with its own stream
+   std::vector<std::thread> workers;
+   for (UInt_t w=0; w<nthreads; w++) {
+      workers.push_back(std::thread([&, w]() {
+         // seed+w in 1..2^32-1, never 0 even if it overflows
+         TRandom3 random(UInt_t((ULong64_t(seed)-1+w)%0xffffffffULL+1));
+         std::vector<Double_t> time, Enr;
+         for (Long64_t i=w; i<nexperiments; i+=nthreads) {
+            Int_t n = Experiment(random, time, Enr);
+            nevents[w] += n;
+            if (handler) handler(i, n, time.data(), Enr.data());
+         }
+      }));
+   }
+   Long64_t total=0;
+   for (UInt_t w=0; w<nthreads; w++) {
+      workers[w].join();
+      total += nevents[w];
+   }
+   return total;
+}
@@ -0,0 +1,81 @@
+#ifndef CNNS_EVENTGENERATOR_H
+#define CNNS_EVENTGENERATOR_H
+
+#include <TNamed.h>
+
+#include <vector>
+#include <functional>
+
+class TH2D;
+class TRandom;
+
+namespace CNNS {
+   class EventGenerator;
+   class Detector;
+}
+
+/**
+ * Toy Monte Carlo of (time, recoil energy) events following a map of
+ * expected events such as SupernovaExperiment::HNevt2. Bins are drawn with
+ * Walker's alias method in constant time, positions inside a bin are
+ * uniform. The number of events in a pseudo experiment fluctuates around
+ * the expected total with Poisson statistics.
+ */
+class CNNS::EventGenerator : public TNamed
+{
+   public:
+      /**
+       * Called for each pseudo experiment with its events, time in second
+       * and nuclear recoil energy in keV, as the axes of the input map.
+       */
+      typedef std::function<void(Long64_t experiment, Int_t n,
+            const Double_t *time, const Double_t *Enr)> Handler;
+
+   protected:
+      Int_t fNt; // number of time bins
+      Int_t fNe; // number of recoil energy bins
+      Double_t fTotal; // expected number of events
+      std::vector<Double_t> fTbins; // edges of time bins
+      std::vector<Double_t> fEbins; // edges of recoil energy bins
+      std::vector<Double_t> fProb; // alias table: probability to keep a bin
+      std::vector<Int_t> fAlias; // alias table: bin used otherwise
+
+   public:
+      EventGenerator() : TNamed(), fNt(0), fNe(0), fTotal(0) {};
+      /**
+       * Build alias table from h, whose content is the number of events per
+       * second per keV. If a detector is given, its efficiency at the bin
+       * centers is applied.
+       */
+      EventGenerator(const TH2D *h, Detector *detector=0);
+      virtual ~EventGenerator() {};
+
+      Double_t Total() const { return fTotal; }
+
+      /**
+       * Draw one pseudo experiment. Return the number of events.
+       */
+      Int_t Experiment(TRandom &random, std::vector<Double_t> &time,
+            std::vector<Double_t> &Enr) const;
+      /**
+       * Generate n events with fixed total, no Poisson fluctuation.
+       * Nothing is generated if the alias table is empty.
+       */
+      void Generate(TRandom &random, Int_t n, Double_t *time,
+            Double_t *Enr) const;
+      /**
+       * Run nexperiments pseudo experiments on nthreads threads. Thread i
+       * uses its own TRandom3 seeded with seed+i, wrapped around to skip 0,
+       * so the result is reproducible for given seed and nthreads. Seed 0,
+       * which would seed TRandom3 from the clock, is rejected and replaced
+       * by the default 4357. The handler is called from
+       * all threads concurrently and must be thread-safe. Return the total
+       * number of generated events.
+       */
+      Long64_t Run(Long64_t nexperiments, Handler handler, UInt_t nthreads=1,
+            UInt_t seed=4357) const;
+
+      ClassDef(EventGenerator,1);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "FluxMoments.h"
+using namespace CNNS;
+
+ClassImp(FluxMoments)
+
+//______________________________________________________________________________
+//
+
+FluxMoments::FluxMoments(Int_t n, Double_t minEv, Double_t maxEv,
+      const Double_t *flux) : TObject(), fMinEv(minEv),
+   fdEv((maxEv-minEv)/(n-1)), fN(n)
+{
+   fG.resize(fgNmoments*n);
+   fM.resize(fgNmoments*n);
+   for (UShort_t k=0; k<fgNmoments; k++) {
+      Double_t *g = &fG[k*n], *m = &fM[k*n];
+      for (Int_t i=0; i<n; i++) {
+         Double_t Ev = fMinEv + fdEv*i;
+         if (Ev<=0) g[i] = k==0 ? flux[i] : 0; // N(0) vanishes
+         else if (k==0) g[i] = flux[i];
+         else if (k==1) g[i] = flux[i]/Ev;
+         else g[i] = flux[i]/Ev/Ev;
+      }
+      // accumulate from the highest energy downwards
+      m[n-1] = 0;
+      for (Int_t i=n-2; i>=0; i--) m[i] = m[i+1] + (g[i]+g[i+1])/2*fdEv;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Double_t FluxMoments::Moment(UShort_t k, Double_t Ev) const
+{
+   if (fN==0) return 0;
+   const Double_t *g = &fG[k*fN], *m = &fM[k*fN];
+   if (Ev<=fMinEv) return m[0];
+   Int_t i = static_cast<Int_t>((Ev-fMinEv)/fdEv);
+   if (i>=fN-1) return 0;
+
+   Double_t x = Ev - (fMinEv + fdEv*i); // distance to grid point i
+   Double_t gx = g[i] + (g[i+1]-g[i])*x/fdEv;
+   return m[i+1] + (gx+g[i+1])/2*(fdEv-x);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t FluxMoments::Integral(const Double_t *a, Double_t minEv) const
+{
+   Double_t sum=0;
+   for (UShort_t k=0; k<fgNmoments; k++) sum += a[k]*Moment(k,minEv);
+   return sum;
+}
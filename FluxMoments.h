@@ -0,0 +1,47 @@
+#ifndef CNNS_FLUXMOMENTS_H
+#define CNNS_FLUXMOMENTS_H
+
+#include <TObject.h>
+
+#include <vector>
+
+namespace CNNS { class FluxMoments; }
+
+/**
+ * Cumulative moments of a neutrino flux N(Ev) tabulated on a uniform grid:
+ * M_k(E) = integral of N(Ev)/Ev^k for Ev from E to the end of the grid,
+ * k=0, 1, 2. A cross section of the form a0 + a1/Ev + a2/Ev^2 folded with
+ * the flux above E is then a0*M_0(E) + a1*M_1(E) + a2*M_2(E).
+ */
+class CNNS::FluxMoments : public TObject
+{
+   public:
+      static const UShort_t fgNmoments=3; // number of moments
+
+   protected:
+      Double_t fMinEv; // first grid point
+      Double_t fdEv; // grid spacing
+      Int_t fN; // number of grid points
+      std::vector<Double_t> fG; // N(Ev)/Ev^k at grid point i: fG[k*fN+i]
+      std::vector<Double_t> fM; // M_k at grid point i: fM[k*fN+i]
+
+   public:
+      FluxMoments() : TObject(), fMinEv(0), fdEv(0), fN(0) {};
+      FluxMoments(Int_t n, Double_t minEv, Double_t maxEv,
+            const Double_t *flux);
+      virtual ~FluxMoments() {};
+
+      Bool_t IsEmpty() const { return fN==0; }
+      /**
+       * M_k(Ev), the integrand is linearly interpolated inside a grid cell.
+       */
+      Double_t Moment(UShort_t k, Double_t Ev) const;
+      /**
+       * Integral of (a[0] + a[1]/Ev + a[2]/Ev^2)*N(Ev) above minEv.
+       */
+      Double_t Integral(const Double_t *a, Double_t minEv) const;
+
+      ClassDef(FluxMoments,1);
+};
+
+#endif
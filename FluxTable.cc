@@ -0,0 +1,187 @@
+#include "FluxTable.h"
+using namespace CNNS;
+
+#include <NEUS/SupernovaModel.h>
+using namespace NEUS;
+
+#include <TH2D.h>
+#include <TAxis.h>
+#include <TError.h>
+
+#include <vector>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+ClassImp(FluxTable)
+
+//______________________________________________________________________________
+//
+
+FluxTable::FluxTable(const char *file) : TNamed(), fData(0), fSize(0),
+   fHeader(0), fTbins(0), fNe(0), fN2(0)
+{
+   int fd = open(file, O_RDONLY);
+   if (fd<0) {
+      Warning("FluxTable", "Cannot open %s!", file);
+      MakeZombie();
+      return;
+   }
+   struct stat st;
+   if (fstat(fd, &st)==0 && st.st_size>=(off_t)sizeof(Header)) {
+      fSize = st.st_size;
+      fData = mmap(0, fSize, PROT_READ, MAP_SHARED, fd, 0);
+      if (fData==MAP_FAILED) fData=0;
+   }
+   close(fd); // the mapping stays valid
+   if (!fData) {
+      Warning("FluxTable", "Cannot map %s!", file);
+      MakeZombie();
+      return;
+   }
+
+   const Header *header = static_cast<const Header*>(fData);
+   Long64_t ntype = header->Ntype-1, nt = header->Nt, nEv = header->NEv;
+   if (strncmp(header->Magic, "CNNSFLUX", 8)!=0
+         || header->Version!=fgVersion || ntype<1 || nt<1 || nEv<2
+         || fSize!=Long64_t(sizeof(Header)+(nt+1)*sizeof(Double_t)
+            +ntype*(1+nt)*nEv*sizeof(Float_t))) {
+      Warning("FluxTable", "%s is not a flux table of version %d!",
+            file, fgVersion);
+      munmap(fData, fSize);
+      fData=0;
+      MakeZombie();
+      return;
+   }
+
+   fHeader = header;
+   fTbins = reinterpret_cast<const Double_t*>(fHeader+1);
+   fNe = reinterpret_cast<const Float_t*>(fTbins+nt+1);
+   fN2 = fNe+ntype*nEv;
+   SetNameTitle(fHeader->Name, fHeader->Title);
+}
+
+//______________________________________________________________________________
+//
+
+FluxTable::~FluxTable()
+{
+   if (fData) munmap(fData, fSize);
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t FluxTable::Convert(SupernovaModel *model, const char *file, Int_t nEv)
+{
+   if (!model || nEv<2) return kFALSE;
+
+   Header header;
+   memset(&header, 0, sizeof(Header));
+   memcpy(header.Magic, "CNNSFLUX", 8);
+   header.Version = fgVersion;
+   header.Ntype = SupernovaModel::fgNtype;
+   header.NEv = nEv;
+   header.EMin = model->EMin();
+   header.EMax = model->EMax();
+   header.Integral = model->HN2()->Integral();
+   strncpy(header.Name, model->GetName(), sizeof(header.Name)-1);
+   strncpy(header.Title, model->GetTitle(), sizeof(header.Title)-1);
+
+   TAxis *axis = model->HN2()->GetXaxis();
+   Int_t nt = header.Nt = axis->GetNbins();
+   std::vector<Double_t> tbins(nt+1);
+   for (Int_t it=0; it<=nt; it++) tbins[it] = axis->GetBinLowEdge(it+1);
+
+   Int_t ntype = header.Ntype-1;
+   std::vector<Float_t> ne(ntype*nEv), n2(ntype*nt*nEv);
+   for (Int_t type=1; type<=ntype; type++) {
+      for (Int_t i=0; i<nEv; i++) {
+         Double_t Ev = header.EMin + (header.EMax-header.EMin)*i/(nEv-1);
+         ne[(type-1)*nEv+i] = model->Ne(type, Ev);
+         for (Int_t it=0; it<nt; it++)
+            n2[((type-1)*nt+it)*nEv+i] =
+               model->N2(type, (tbins[it]+tbins[it+1])/2, Ev);
+      }
+   }
+
+   std::ofstream output(file, std::ios::binary|std::ios::trunc);
+   output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+   output.write(reinterpret_cast<const char*>(tbins.data()),
+         tbins.size()*sizeof(Double_t));
+   output.write(reinterpret_cast<const char*>(ne.data()),
+         ne.size()*sizeof(Float_t));
+   output.write(reinterpret_cast<const char*>(n2.data()),
+         n2.size()*sizeof(Float_t));
+   if (!output) {
+      ::Warning("FluxTable::Convert", "Cannot write %s!", file);
+      return kFALSE;
+   }
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t FluxTable::Locate(Double_t Ev, Int_t &i, Double_t &w) const
+{
+   if (!fHeader || Ev<fHeader->EMin || Ev>fHeader->EMax) return kFALSE;
+   Double_t x = (Ev-fHeader->EMin)/(fHeader->EMax-fHeader->EMin)
+      *(fHeader->NEv-1);
+   i = static_cast<Int_t>(x);
+   if (i>fHeader->NEv-2) i=fHeader->NEv-2;
+   w = x-i;
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t FluxTable::Ne(UShort_t type, Double_t Ev) const
+{
+   Int_t i;
+   Double_t w;
+   if (!Locate(Ev, i, w) || type<1 || type>=fHeader->Ntype) return 0;
+   const Float_t *row = fNe+(type-1)*fHeader->NEv;
+   return (1-w)*row[i] + w*row[i+1];
+}
+
+//______________________________________________________________________________
+//
+
+Double_t FluxTable::N2(UShort_t type, Double_t time, Double_t Ev) const
+{
+   Int_t i;
+   Double_t w;
+   if (!Locate(Ev, i, w) || type<1 || type>=fHeader->Ntype) return 0;
+   Int_t nt = fHeader->Nt;
+   if (time<fTbins[0] || time>fTbins[nt]) return 0;
+
+   // time bin whose center is the last one not after time
+   Int_t low=0, high=nt;
+   while (high-low>1) {
+      Int_t mid = (low+high)/2;
+      if (fTbins[mid]<=time) low=mid;
+      else high=mid;
+   }
+   Int_t it = low;
+   if (time<(fTbins[it]+fTbins[it+1])/2) it--;
+   Double_t u=0;
+   if (it<0) it=0; // before the first center
+   else if (it>=nt-1) it=nt-1; // after the last center
+   else {
+      Double_t c1 = (fTbins[it]+fTbins[it+1])/2;
+      Double_t c2 = (fTbins[it+1]+fTbins[it+2])/2;
+      u = (time-c1)/(c2-c1);
+   }
+
+   const Float_t *row1 = fN2+((type-1)*nt+it)*fHeader->NEv;
+   Double_t n2 = (1-w)*row1[i] + w*row1[i+1];
+   if (u==0) return n2;
+   const Float_t *row2 = row1+fHeader->NEv;
+   return (1-u)*n2 + u*((1-w)*row2[i] + w*row2[i+1]);
+}
@@ -0,0 +1,88 @@
+#ifndef CNNS_FLUXTABLE_H
+#define CNNS_FLUXTABLE_H
+
+#include <TNamed.h>
+
+namespace NEUS { class SupernovaModel; }
+namespace CNNS { class FluxTable; }
+
+/**
+ * Neutrino fluxes of a supernova model read from a binary file written by
+ * Convert. The file is mapped into memory read-only and the fluxes are
+ * interpolated directly in the mapped pages, so opening a table costs no
+ * parsing or copying, and processes reading the same file share its pages.
+ *
+ * Layout, in the byte order of the machine that wrote it:
+ * Header, Nt+1 edges of time bins [second] (Double_t),
+ * Ne[(type-1)*NEv+iEv] and N2[((type-1)*Nt+it)*NEv+iEv] (Float_t) for
+ * type 1 to Ntype-1 on NEv neutrino energies evenly spaced between EMin
+ * and EMax [MeV]. N2 is tabulated at the centers of time bins. Type 0 is
+ * not stored since SupernovaExperiment sums it up from the others.
+ */
+class CNNS::FluxTable : public TNamed
+{
+   public:
+      static const Int_t fgVersion=1; // increase it when the layout changes
+
+      struct Header {
+         char Magic[8]; // "CNNSFLUX"
+         Int_t Version; // fgVersion of the writer
+         Int_t Ntype; // number of neutrino types including type 0
+         Int_t Nt; // number of time bins
+         Int_t NEv; // number of neutrino energies
+         Double_t EMin; // lowest neutrino energy [MeV]
+         Double_t EMax; // highest neutrino energy [MeV]
+         Double_t Integral; // HN2()->Integral() of the model
+         char Name[64]; // name of the model
+         char Title[128]; // title of the model
+      };
+
+   protected:
+      void *fData; //! mapped file
+      Long64_t fSize; //! size of the mapping in byte
+      const Header *fHeader; //! beginning of fData
+      const Double_t *fTbins; //! edges of time bins
+      const Float_t *fNe; //! Ne of types 1 to Ntype-1
+      const Float_t *fN2; //! N2 of types 1 to Ntype-1
+
+      /**
+       * Index i and weight w of Ev between the energies i and i+1.
+       * Return kFALSE if Ev is outside of [EMin, EMax].
+       */
+      Bool_t Locate(Double_t Ev, Int_t &i, Double_t &w) const;
+
+   public:
+      FluxTable() : TNamed(), fData(0), fSize(0), fHeader(0), fTbins(0),
+      fNe(0), fN2(0) {};
+      /**
+       * Map file into memory. The table is a zombie if the file cannot be
+       * mapped or is not a table of fgVersion.
+       */
+      FluxTable(const char *file);
+      virtual ~FluxTable();
+
+      /**
+       * Tabulate Ne and N2 of model on its time bins and nEv neutrino
+       * energies and write them to file. Return kFALSE if it fails.
+       */
+      static Bool_t Convert(NEUS::SupernovaModel *model, const char *file,
+            Int_t nEv=500);
+
+      Double_t Ne(UShort_t type, Double_t Ev) const;
+      /**
+       * N2 interpolated linearly in energy and between time bin centers,
+       * 0 outside of the time bins.
+       */
+      Double_t N2(UShort_t type, Double_t time, Double_t Ev) const;
+
+      Double_t EMin() const { return fHeader ? fHeader->EMin : 0; }
+      Double_t EMax() const { return fHeader ? fHeader->EMax : 0; }
+      Double_t Integral() const { return fHeader ? fHeader->Integral : 0; }
+      Int_t Nt() const { return fHeader ? fHeader->Nt : 0; }
+      Int_t NEv() const { return fHeader ? fHeader->NEv : 0; }
+      const Double_t* TimeBins() const { return fTbins; }
+
+      ClassDef(FluxTable,1);
+};
+
+#endif
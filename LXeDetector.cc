@@ -9,6 +9,14 @@ using namespace MAD;
 //______________________________________________________________________________
 //
 
+LXeDetector::~LXeDetector()
+{
+   if (fPEofEnr) delete fPEofEnr;
+}
+
+//______________________________________________________________________________
+//
+
 void LXeDetector::SetThreshold(Double_t threshold)
 {
    if (!TargetMaterial) {
@@ -36,3 +44,21 @@ void LXeDetector::SetThreshold(Double_t threshold)
 
 //______________________________________________________________________________
 //
+
+Double_t LXeDetector::MeanPE(Double_t Enr)
+{
+   if (!TargetMaterial || LightYield==0.)
+      return ScintillationDetector::MeanPE(Enr);
+   TString material(TargetMaterial->GetName());
+   if (material.CompareTo("LXe")!=0)
+      return ScintillationDetector::MeanPE(Enr);
+
+   if (!fPEofEnr || fPELightYield!=LightYield) {
+      LiquidXenon *LXe = (LiquidXenon*) TargetMaterial;
+      TGraph *g = LXe->EnrPE(LightYield);
+      if (fPEofEnr) delete fPEofEnr;
+      fPEofEnr = new TGraph(g->GetN(), g->GetY(), g->GetX());
+      fPELightYield = LightYield;
+   }
+   return fPEofEnr->Eval(Enr/keV)*PE;
+}
@@ -3,20 +3,31 @@
 
 #include "ScintillationDetector.h"
 
+class TGraph;
+
 namespace CNNS { class LXeDetector; }
 
 class CNNS::LXeDetector : public CNNS::ScintillationDetector
 {
+   protected:
+      TGraph *fPEofEnr; //! inverse of LiquidXenon::EnrPE, in keV and PE
+      Double_t fPELightYield; //! light yield used to build fPEofEnr
+
    public:
-      LXeDetector() : ScintillationDetector() {};
+      LXeDetector() : ScintillationDetector(), fPEofEnr(0), fPELightYield(0) {};
       LXeDetector(const char *name, const char *title) :
-         ScintillationDetector(name, title) {};
+         ScintillationDetector(name, title), fPEofEnr(0), fPELightYield(0) {};
 
-      virtual ~LXeDetector() {};
+      virtual ~LXeDetector();
 
       void SetThreshold(Double_t threshold);
+      /**
+       * Mean number of PE from the quenched scintillation of LXe, i.e. the
+       * inverse of LiquidXenon::EnrPE(LightYield) also used by SetThreshold.
+       */
+      Double_t MeanPE(Double_t Enr);
 
-      ClassDef(LXeDetector,1);
+      ClassDef(LXeDetector,2);
 };
 
 #endif
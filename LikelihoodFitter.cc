@@ -0,0 +1,176 @@
+#include "Detector.h"
+#include "LikelihoodFitter.h"
+using namespace CNNS;
+
+#include <TH2D.h>
+
+#include <cmath>
+
+ClassImp(LikelihoodFitter)
+
+// floor of the expected density per event, so that an event in an empty
+// cell of a map without background costs a finite penalty instead of -inf
+static const Double_t kMinDensity = 1e-300;
+
+//______________________________________________________________________________
+//
+
+LikelihoodFitter::~LikelihoodFitter()
+{
+   for (size_t m=0; m<fMaps.size(); m++) delete fMaps[m];
+}
+
+//______________________________________________________________________________
+//
+
+Int_t LikelihoodFitter::AddModel(const TH2D *nevt2, Double_t d0,
+      Detector *detector)
+{
+   TH2D *h = new TH2D(*nevt2);
+   h->SetName(Form("%s-%d",nevt2->GetName(),Int_t(fMaps.size())));
+   h->SetDirectory(0);
+
+   // expected events and area of the map, with efficiency
+   Int_t ne = h->GetNbinsY();
+   std::vector<Double_t> eff(ne, 1.), Enr(ne);
+   if (detector) {
+      for (Int_t iy=1; iy<=ne; iy++)
+         Enr[iy-1] = h->GetYaxis()->GetBinCenter(iy)*keV;
+      detector->Efficiencies(ne, Enr.data(), eff.data());
+   }
+   Double_t total=0;
+   for (Int_t iy=1; iy<=ne; iy++)
+      for (Int_t ix=1; ix<=h->GetNbinsX(); ix++)
+         total += h->GetBinContent(ix,iy)*eff[iy-1]
+            *h->GetXaxis()->GetBinWidth(ix)*h->GetYaxis()->GetBinWidth(iy);
+   TAxis *t = h->GetXaxis(), *e = h->GetYaxis();
+   Double_t area = (t->GetBinUpEdge(t->GetNbins())-t->GetBinLowEdge(1))
+      *(e->GetBinUpEdge(e->GetNbins())-e->GetBinLowEdge(1));
+
+   fMaps.push_back(h);
+   fD0.push_back(d0);
+   fTotal.push_back(total);
+   fArea.push_back(area);
+   fDetectors.push_back(detector);
+   fS.push_back(0);
+   fError.push_back(0);
+   fLnL.push_back(0);
+   return fMaps.size()-1;
+}
+
+//______________________________________________________________________________
+//
+
+void LikelihoodFitter::SetEvents(Int_t n, const Double_t *time,
+      const Double_t *Enr)
+{
+   fTime.assign(time, time+n);
+   fEnr.assign(Enr, Enr+n);
+   fKernel.clear();
+   fNkernel=0;
+}
+
+//______________________________________________________________________________
+//
+
+void LikelihoodFitter::BuildKernel()
+{
+   Int_t n = Nevents();
+   fKernel.resize(Nmodels()*n);
+   std::vector<Double_t> eff(n), Enr(n);
+   for (Int_t i=0; i<n; i++) Enr[i] = fEnr[i]*keV;
+   for (Int_t m=fNkernel; m<Nmodels(); m++) {
+      if (fDetectors[m]) fDetectors[m]->Efficiencies(n, Enr.data(), eff.data());
+      else eff.assign(n, 1.);
+      TH2D *h = fMaps[m];
+      Double_t *k = &fKernel[m*n];
+      for (Int_t i=0; i<n; i++)
+         k[i] = h->GetBinContent(h->FindFixBin(fTime[i],fEnr[i]))*eff[i];
+   }
+   fNkernel = Nmodels();
+}
+
+//______________________________________________________________________________
+//
+
+Double_t LikelihoodFitter::LnL(Int_t model, Double_t s)
+{
+   if (fNkernel<Nmodels()) BuildKernel();
+   Int_t n = Nevents();
+   const Double_t *k = &fKernel[model*n];
+   Double_t b = Background, lnL = -s*fTotal[model]-b*fArea[model];
+   for (Int_t i=0; i<n; i++) {
+      Double_t density = s*k[i]+b;
+      lnL += std::log(density>kMinDensity ? density : kMinDensity);
+   }
+   return lnL;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t LikelihoodFitter::FitModel(Int_t model, Double_t &error)
+{
+   Int_t n = Nevents();
+   const Double_t *k = &fKernel[model*n];
+   Double_t b = Background, U = fTotal[model];
+   if (U<=0 || n==0) {
+      error=0;
+      return 0;
+   }
+
+   // without background dlnL/ds = -U + n/s = 0
+   if (b<=0) {
+      error = std::sqrt(Double_t(n))/U;
+      return n/U;
+   }
+
+   // Newton's method on s>=0, starting from background subtracted counts
+   Double_t s = (n-b*fArea[model])/U, hessian=0;
+   if (s<=0) s = 1./U;
+   for (Int_t iter=0; iter<100; iter++) {
+      Double_t gradient=-U;
+      hessian=0;
+      for (Int_t i=0; i<n; i++) {
+         Double_t r = k[i]/(s*k[i]+b);
+         gradient += r;
+         hessian -= r*r;
+      }
+      if (hessian>=0) break;
+      Double_t step = -gradient/hessian;
+      if (s+step<0) step = -s/2; // stay inside s>=0
+      s += step;
+      if (std::fabs(step)<1e-10*s) break;
+   }
+   error = hessian<0 ? 1/std::sqrt(-hessian) : 0;
+   return s;
+}
+
+//______________________________________________________________________________
+//
+
+Int_t LikelihoodFitter::Fit()
+{
+   if (Nmodels()==0) {
+      Warning("Fit","No model to fit!");
+      return -1;
+   }
+   if (fNkernel<Nmodels()) BuildKernel();
+
+   Int_t best=0;
+   for (Int_t m=0; m<Nmodels(); m++) {
+      fS[m] = FitModel(m, fError[m]);
+      fLnL[m] = LnL(m, fS[m]);
+      if (fLnL[m]>fLnL[best]) best=m;
+   }
+   return best;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t LikelihoodFitter::Distance(Int_t model, Double_t norm) const
+{
+   if (fS[model]<=0) return 0;
+   return fD0[model]*std::sqrt(norm/fS[model]);
+}
@@ -0,0 +1,87 @@
+#ifndef CNNS_LIKELIHOODFITTER_H
+#define CNNS_LIKELIHOODFITTER_H
+
+#include <TNamed.h>
+
+#include <vector>
+
+class TH2D;
+
+namespace CNNS {
+   class LikelihoodFitter;
+   class Detector;
+}
+
+/**
+ * Unbinned extended likelihood fit of observed (time, recoil energy)
+ * events to a set of supernova models, each given as a map of expected
+ * events such as SupernovaExperiment::HNevt2 at a reference distance d0.
+ * The expected density of a model is s*nevt2(t,Enr)*efficiency(Enr) plus
+ * a flat background, where the strength s = norm*(d0/d)^2 combines the
+ * normalization of the flux and the distance d, which can not be told
+ * apart by a fit. Kernel rows nevt2(t_i,Enr_i)*efficiency(Enr_i) of all
+ * events are computed once per model, so that each likelihood evaluation
+ * is a loop over contiguous arrays. s is found by Newton's method with
+ * analytic derivatives, or directly if there is no background.
+ */
+class CNNS::LikelihoodFitter : public TNamed
+{
+   public:
+      Double_t Background; // background events per second per keV
+
+   protected:
+      std::vector<TH2D*> fMaps; // expected events per second per keV
+      std::vector<Double_t> fD0; // distance of each map
+      std::vector<Double_t> fTotal; // expected events of each map
+      std::vector<Double_t> fArea; // (time, Enr) area of each map
+      std::vector<Detector*> fDetectors; //! for efficiencies, not owned
+      std::vector<Double_t> fTime; // observed times [second]
+      std::vector<Double_t> fEnr; // observed recoil energies [keV]
+      std::vector<Double_t> fKernel; //! [model*nevt+event]
+      Int_t fNkernel; //! number of models in fKernel
+
+      std::vector<Double_t> fS; // fitted strength of each model
+      std::vector<Double_t> fError; // its uncertainty
+      std::vector<Double_t> fLnL; // maximal log-likelihood of each model
+
+      void BuildKernel(); // rows of models added after the last call
+      Double_t FitModel(Int_t model, Double_t &error);
+
+   public:
+      LikelihoodFitter() : TNamed("fitter","likelihood fitter"),
+      Background(0), fNkernel(0) {};
+      virtual ~LikelihoodFitter();
+
+      /**
+       * Add a model from nevt2, calculated at distance d0. If a detector is
+       * given, its efficiency is applied. Return the index of the model.
+       */
+      Int_t AddModel(const TH2D *nevt2, Double_t d0, Detector *detector=0);
+      /**
+       * Set observed events, time in second and recoil energy in keV as
+       * the axes of the maps, e.g. from EventGenerator.
+       */
+      void SetEvents(Int_t n, const Double_t *time, const Double_t *Enr);
+      Int_t Nmodels() const { return fMaps.size(); }
+      Int_t Nevents() const { return fTime.size(); }
+
+      /**
+       * Log-likelihood of a model with strength s.
+       */
+      Double_t LnL(Int_t model, Double_t s);
+      /**
+       * Fit all models, return the index of the best one.
+       */
+      Int_t Fit();
+      Double_t Strength(Int_t model) const { return fS[model]; }
+      Double_t StrengthError(Int_t model) const { return fError[model]; }
+      Double_t MaxLnL(Int_t model) const { return fLnL[model]; }
+      /**
+       * Distance for a flux normalization norm, d0*sqrt(norm/s).
+       */
+      Double_t Distance(Int_t model, Double_t norm=1) const;
+
+      ClassDef(LikelihoodFitter,1);
+};
+
+#endif
@@ -5,4 +5,16 @@
 #pragma link C++ class CNNS::LXeDetector+;
 #pragma link C++ class CNNS::XMASS835kg+;
 #pragma link C++ class CNNS::SupernovaExperiment+;
+#pragma link C++ class CNNS::XSTable+;
+#pragma link C++ class CNNS::FluxMoments+;
+#pragma link C++ class CNNS::ResponseMatrix+;
+#pragma link C++ class CNNS::EventGenerator+;
+#pragma link C++ class CNNS::CatalogScan+;
+#pragma link C++ struct CNNS::CatalogScan::Model+;
+#pragma link C++ class CNNS::BurstMonitor+;
+#pragma link C++ class CNNS::LikelihoodFitter+;
+#pragma link C++ struct CNNS::Stats+;
+#pragma link C++ class CNNS::ResultCache+;
+#pragma link C++ class CNNS::FluxTable+;
+#pragma link C++ class CNNS::Snapshot+;
 #endif
@@ -0,0 +1,118 @@
+#include "XSTable.h"
+#include "ResponseMatrix.h"
+using namespace CNNS;
+
+#include <TH2D.h>
+
+ClassImp(ResponseMatrix)
+
+//______________________________________________________________________________
+//
+
+ResponseMatrix::ResponseMatrix(const XSTable *table, const Double_t *ebins,
+      Double_t scale) : TNamed(Form("ResponseMatrix%s",table->GetName()),
+         table->GetTitle()), fNEr(table->NEr()), fNEv(table->NEv())
+{
+   fEdges.assign(ebins, ebins+fNEr+1);
+
+   // trapezoidal weights of the uniform neutrino energy grid
+   const Double_t *Ev = table->Ev();
+   Double_t dEv = (Ev[fNEv-1]-Ev[0])/(fNEv-1);
+   std::vector<Double_t> weight(fNEv, dEv);
+   weight[0] = weight[fNEv-1] = dEv/2;
+
+   fK.resize(fNEr*fNEv);
+   fFirst.resize(fNEr);
+   for (Int_t i=0; i<fNEr; i++) {
+      const Double_t *row = table->Row(i);
+      fFirst[i]=fNEv;
+      for (Int_t j=0; j<fNEv; j++) {
+         fK[i*fNEv+j] = row[j]*weight[j]*scale;
+         if (row[j]!=0 && fFirst[i]==fNEv) fFirst[i]=j;
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Double_t ResponseMatrix::Apply(Int_t iEr, const Double_t *flux) const
+{
+   const Double_t *k = &fK[iEr*fNEv];
+   Double_t sum=0;
+   for (Int_t j=fFirst[iEr]; j<fNEv; j++) sum += k[j]*flux[j];
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+void ResponseMatrix::Apply(const Double_t *flux, Double_t *nevt) const
+{
+   for (Int_t i=0; i<fNEr; i++) nevt[i] = Apply(i, flux);
+}
+
+//______________________________________________________________________________
+//
+
+void ResponseMatrix::Apply(Int_t nt, const Double_t *flux,
+      Double_t *nevt) const
+{
+   for (Int_t i=0; i<fNEr*nt; i++) nevt[i]=0;
+
+   // blocks of 64 recoil energies x 64 neutrino energies x 64 time bins
+   // keep K, flux and nevt in L1/L2 cache, the innermost loop runs over
+   // contiguous time bins so that it can be vectorized
+   const Int_t bs=64;
+   for (Int_t i0=0; i0<fNEr; i0+=bs) {
+      Int_t i1 = i0+bs<fNEr ? i0+bs : fNEr;
+      for (Int_t j0=0; j0<fNEv; j0+=bs) {
+         Int_t j1 = j0+bs<fNEv ? j0+bs : fNEv;
+         for (Int_t t0=0; t0<nt; t0+=bs) {
+            Int_t t1 = t0+bs<nt ? t0+bs : nt;
+            for (Int_t i=i0; i<i1; i++) {
+               Double_t *n = &nevt[i*nt];
+               Int_t first = fFirst[i]>j0 ? fFirst[i] : j0;
+               for (Int_t j=first; j<j1; j++) {
+                  const Double_t k = fK[i*fNEv+j];
+                  const Double_t *f = &flux[j*nt];
+                  for (Int_t t=t0; t<t1; t++) n[t] += k*f[t];
+               }
+            }
+         }
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* ResponseMatrix::Apply(const char *name, const Double_t *flux,
+      Double_t norm) const
+{
+   std::vector<Double_t> nevt(fNEr);
+   Apply(flux, nevt.data());
+
+   TH1D *h = new TH1D(name, "", fNEr, fEdges.data());
+   for (Int_t i=0; i<fNEr; i++) h->SetBinContent(i+1, nevt[i]*norm);
+   h->SetXTitle("true nuclear recoil energy [keV]");
+   return h;
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* ResponseMatrix::Apply(const char *name, Int_t nt,
+      const Double_t *tbins, const Double_t *flux, Double_t norm) const
+{
+   std::vector<Double_t> nevt(fNEr*nt);
+   Apply(nt, flux, nevt.data());
+
+   TH2D *h = new TH2D(name, "", nt, tbins, fNEr, fEdges.data());
+   for (Int_t i=0; i<fNEr; i++)
+      for (Int_t t=0; t<nt; t++)
+         h->SetBinContent(t+1, i+1, nevt[i*nt+t]*norm);
+   h->GetXaxis()->SetTitle("time [second]");
+   h->GetYaxis()->SetTitle("nuclear recoil energy [keV]");
+   return h;
+}
@@ -0,0 +1,75 @@
+#ifndef CNNS_RESPONSEMATRIX_H
+#define CNNS_RESPONSEMATRIX_H
+
+#include <TNamed.h>
+
+#include <vector>
+
+class TH1D;
+class TH2D;
+
+namespace CNNS {
+   class ResponseMatrix;
+   class XSTable;
+}
+
+/**
+ * Response K(Er, Ev) of a target to neutrinos, i.e., dXS(Er, Ev) times the
+ * trapezoidal weight of Ev in the neutrino energy grid of a XSTable. A flux
+ * tabulated on the same grid is turned into a recoil spectrum by a
+ * matrix-vector product, a flux tabulated at several times into a
+ * time-recoil map by a matrix-matrix product.
+ */
+class CNNS::ResponseMatrix : public TNamed
+{
+   protected:
+      Int_t fNEr; // number of recoil energy bins (rows)
+      Int_t fNEv; // number of neutrino energies (columns)
+      std::vector<Double_t> fEdges; // edges of recoil energy bins [keV]
+      std::vector<Double_t> fK; // fK[iEr*fNEv+iEv]
+      std::vector<Int_t> fFirst; // first non-zero column in each row
+
+   public:
+      ResponseMatrix() : TNamed(), fNEr(0), fNEv(0) {};
+      /**
+       * Build response from table. Row i corresponds to the recoil bin
+       * [ebins[i], ebins[i+1]] in keV, which must match table->Er()[i].
+       * All elements are multiplied by scale.
+       */
+      ResponseMatrix(const XSTable *table, const Double_t *ebins,
+            Double_t scale=1);
+      virtual ~ResponseMatrix() {};
+
+      Int_t NEr() const { return fNEr; }
+      Int_t NEv() const { return fNEv; }
+      const Double_t* Edges() const { return fEdges.data(); }
+
+      /**
+       * Sum of K[iEr][iEv]*flux[iEv] for one recoil bin.
+       */
+      Double_t Apply(Int_t iEr, const Double_t *flux) const;
+      /**
+       * nevt[iEr] = sum of K[iEr][iEv]*flux[iEv].
+       */
+      void Apply(const Double_t *flux, Double_t *nevt) const;
+      /**
+       * nevt[iEr*nt+it] = sum of K[iEr][iEv]*flux[iEv*nt+it], evaluated in
+       * blocks that fit into cache.
+       */
+      void Apply(Int_t nt, const Double_t *flux, Double_t *nevt) const;
+
+      /**
+       * Return a new recoil spectrum scaled by norm. Caller owns it.
+       */
+      TH1D* Apply(const char *name, const Double_t *flux,
+            Double_t norm=1) const;
+      /**
+       * Return a new time-recoil map with nt time bins. Caller owns it.
+       */
+      TH2D* Apply(const char *name, Int_t nt, const Double_t *tbins,
+            const Double_t *flux, Double_t norm=1) const;
+
+      ClassDef(ResponseMatrix,1);
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "ResultCache.h"
+using namespace CNNS;
+
+#include <TH1.h>
+
+ClassImp(ResultCache)
+
+//______________________________________________________________________________
+//
+
+ResultCache::ResultCache(Long64_t budget) :
+   TNamed("resultCache","histograms in memory"), fBudget(budget), fBytes(0)
+{
+}
+
+//______________________________________________________________________________
+//
+
+ResultCache::~ResultCache()
+{
+   Clear();
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t ResultCache::Size(const TH1 *h)
+{
+   Long64_t ncells = h->GetNcells();
+   return ncells*sizeof(Double_t)*(h->GetSumw2N()>0 ? 2 : 1);
+}
+
+//______________________________________________________________________________
+//
+
+const TH1* ResultCache::Get(const char *key)
+{
+   std::map<TString, std::list<Entry>::iterator>::iterator it =
+      fIndex.find(key);
+   if (it==fIndex.end()) return 0;
+   fEntries.splice(fEntries.begin(), fEntries, it->second);
+   return it->second->Hist;
+}
+
+//______________________________________________________________________________
+//
+
+void ResultCache::Put(const char *key, const TH1 *h)
+{
+   std::map<TString, std::list<Entry>::iterator>::iterator it =
+      fIndex.find(key);
+   if (it!=fIndex.end()) {
+      fBytes -= it->second->Bytes;
+      delete it->second->Hist;
+      fEntries.erase(it->second);
+      fIndex.erase(it);
+   }
+   if (Size(h)>fBudget) return; // would be evicted at once, e.g. budget 0
+
+   Entry entry;
+   entry.Key = key;
+   entry.Hist = (TH1*) h->Clone(key);
+   entry.Hist->SetDirectory(0);
+   entry.Bytes = Size(h);
+   fEntries.push_front(entry);
+   fIndex[entry.Key] = fEntries.begin();
+   fBytes += entry.Bytes;
+   Evict();
+}
+
+//______________________________________________________________________________
+//
+
+void ResultCache::Evict()
+{
+   while (fBytes>fBudget && !fEntries.empty()) {
+      Entry &last = fEntries.back();
+      fBytes -= last.Bytes;
+      fIndex.erase(last.Key);
+      delete last.Hist;
+      fEntries.pop_back();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void ResultCache::Clear(Option_t *option)
+{
+   for (std::list<Entry>::iterator it=fEntries.begin(); it!=fEntries.end();
+         it++) delete it->Hist;
+   fEntries.clear();
+   fIndex.clear();
+   fBytes=0;
+}
@@ -0,0 +1,65 @@
+#ifndef CNNS_RESULTCACHE_H
+#define CNNS_RESULTCACHE_H
+
+#include <TNamed.h>
+#include <TString.h>
+
+#include <map>
+#include <list>
+
+class TH1;
+
+namespace CNNS { class ResultCache; }
+
+/**
+ * Copies of histograms in memory, keyed by SupernovaExperiment::CacheKey,
+ * i.e. by supernova model, target, type, binning and integration. The
+ * least recently used ones are deleted when their total size exceeds the
+ * budget, so that results of several models and detectors are kept while
+ * memory stays bounded.
+ */
+class CNNS::ResultCache : public TNamed
+{
+   protected:
+      struct Entry {
+         TString Key;
+         TH1 *Hist; // owned copy
+         Long64_t Bytes;
+      };
+      std::list<Entry> fEntries; //! most recently used first
+      std::map<TString, std::list<Entry>::iterator> fIndex; //! by key
+      Long64_t fBudget; // maximal total size in byte
+      Long64_t fBytes; //! total size of entries
+
+      void Evict(); // delete least recently used entries above budget
+
+   public:
+      /**
+       * The default budget is small, as every experiment owns a cache, and
+       * nothing is kept with budget 0.
+       */
+      ResultCache(Long64_t budget=32*1024*1024);
+      virtual ~ResultCache();
+
+      /**
+       * Histogram kept under key, NULL if there is none. It becomes the most
+       * recently used one and stays owned by the cache.
+       */
+      const TH1* Get(const char *key);
+      /**
+       * Keep a copy of h under key, replacing an older one.
+       */
+      void Put(const char *key, const TH1 *h);
+
+      void SetBudget(Long64_t bytes) { fBudget=bytes; Evict(); }
+      Long64_t Budget() const { return fBudget; }
+      Long64_t Bytes() const { return fBytes; }
+      Int_t Nentries() const { return fEntries.size(); }
+      void Clear(Option_t *option=""); // delete all entries
+
+      static Long64_t Size(const TH1 *h); // bytes of contents and errors
+
+      ClassDef(ResultCache,1);
+};
+
+#endif
@@ -1,3 +1,148 @@
 #include "ScintillationDetector.h"
 using namespace CNNS;
+
+#include <TH1D.h>
+#include <TH2D.h>
+
+#include <cmath>
+
 ClassImp(ScintillationDetector)
+
+//______________________________________________________________________________
+//
+
+Int_t ScintillationDetector::DefaultNPE(const TAxis *axis)
+{
+   Double_t Emax = axis->GetBinUpEdge(axis->GetNbins())*keV;
+   Double_t mean = MeanPE(Emax)*(1+5*QuenchingSpread);
+   if (mean<0) mean=0;
+   return static_cast<Int_t>(std::ceil(mean+5*std::sqrt(mean)))+1;
+}
+
+//______________________________________________________________________________
+//
+
+void ScintillationDetector::BuildResponse(const TAxis *axis, Int_t npe)
+{
+   Int_t nbins = axis->GetNbins();
+   Bool_t same = fResLightYield==LightYield && fResSpread==QuenchingSpread
+      && fResNPE==npe && Int_t(fResEdges.size())==nbins+1;
+   for (Int_t i=0; same && i<=nbins; i++)
+      same = fResEdges[i]==axis->GetBinLowEdge(i+1);
+   if (same) return;
+
+   fResLightYield = LightYield;
+   fResSpread = QuenchingSpread;
+   fResNPE = npe;
+   fResEdges.resize(nbins+1);
+   for (Int_t i=0; i<=nbins; i++) fResEdges[i]=axis->GetBinLowEdge(i+1);
+   fResFirst.assign(nbins, 0);
+   fResOffset.assign(nbins+1, 0);
+   fResK.clear();
+
+   // 5-point Gauss-Hermite quadrature for the quenching spread
+   const Int_t nq=5;
+   const Double_t x[nq] = {-2.020182870, -0.958572465, 0.,
+      0.958572465, 2.020182870};
+   const Double_t w[nq] = {0.019953242, 0.393619323, 0.945308720,
+      0.393619323, 0.019953242};
+
+   std::vector<Double_t> p(npe+1);
+   for (Int_t i=0; i<nbins; i++) {
+      Double_t mean = MeanPE(axis->GetBinCenter(i+1)*keV);
+      if (mean<0) mean=0;
+      p.assign(npe+1, 0);
+      for (Int_t q=0; q<nq; q++) {
+         Double_t mu = mean, weight = 1;
+         if (QuenchingSpread>0) {
+            mu = mean*(1+QuenchingSpread*std::sqrt(2.)*x[q]);
+            weight = w[q]/std::sqrt(pi);
+         } else if (q>0) break;
+         if (mu<=0) { p[0]+=weight; continue; }
+         // Poisson from its mode up and down to stay in range for large mu
+         Int_t mode = static_cast<Int_t>(mu);
+         if (mode>npe) mode=npe;
+         Double_t pk = std::exp(mode*std::log(mu)-mu-std::lgamma(mode+1.));
+         Double_t pm = pk;
+         for (Int_t k=mode; k<=npe && pk>0; k++) {
+            p[k] += weight*pk;
+            pk *= mu/(k+1);
+         }
+         pk = pm;
+         for (Int_t k=mode-1; k>=0 && pk>0; k--) {
+            pk *= (k+1)/mu;
+            p[k] += weight*pk;
+         }
+      }
+      // keep only non-negligible entries
+      Int_t first=0, last=npe;
+      while (first<last && p[first]<1e-12) first++;
+      while (last>first && p[last]<1e-12) last--;
+      fResFirst[i] = first;
+      for (Int_t k=first; k<=last; k++) fResK.push_back(p[k]);
+      fResOffset[i+1] = fResK.size();
+   }
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* ScintillationDetector::Smear(const TH1D *h, Int_t npe)
+{
+   const TAxis *axis = h->GetXaxis();
+   if (npe<=0) npe = DefaultNPE(axis);
+   BuildResponse(axis, npe);
+
+   TH1D *hPE = new TH1D(Form("%sPE",h->GetName()),
+         Form("%s;number of PE;events per PE",h->GetTitle()),
+         npe+1,-0.5,npe+0.5);
+   std::vector<Double_t> nevt(npe+1, 0.);
+   for (Int_t i=0; i<axis->GetNbins(); i++) {
+      Double_t n = h->GetBinContent(i+1)*axis->GetBinWidth(i+1);
+      if (n==0) continue;
+      const Double_t *k = &fResK[fResOffset[i]];
+      Double_t *out = &nevt[fResFirst[i]];
+      for (Int_t j=0; j<fResOffset[i+1]-fResOffset[i]; j++) out[j] += n*k[j];
+   }
+   for (Int_t j=0; j<=npe; j++) hPE->SetBinContent(j+1, nevt[j]);
+   return hPE;
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* ScintillationDetector::Smear(const TH2D *h, Int_t npe)
+{
+   const TAxis *taxis = h->GetXaxis();
+   const TAxis *axis = h->GetYaxis();
+   if (npe<=0) npe = DefaultNPE(axis);
+   BuildResponse(axis, npe);
+
+   Int_t nt = taxis->GetNbins();
+   std::vector<Double_t> tbins(nt+1);
+   for (Int_t it=0; it<=nt; it++) tbins[it]=taxis->GetBinLowEdge(it+1);
+
+   TH2D *hPE = new TH2D(Form("%sPE",h->GetName()),
+         Form("%s;%s;number of PE",h->GetTitle(),taxis->GetTitle()),
+         nt,tbins.data(),npe+1,-0.5,npe+0.5);
+   // one pass over recoil energy bins, all time bins at once
+   std::vector<Double_t> nevt((npe+1)*nt, 0.), n(nt);
+   for (Int_t i=0; i<axis->GetNbins(); i++) {
+      Double_t de = axis->GetBinWidth(i+1);
+      Bool_t empty = kTRUE;
+      for (Int_t it=0; it<nt; it++) {
+         n[it] = h->GetBinContent(it+1,i+1)*de;
+         if (n[it]!=0) empty = kFALSE;
+      }
+      if (empty) continue;
+      const Double_t *k = &fResK[fResOffset[i]];
+      for (Int_t j=0; j<fResOffset[i+1]-fResOffset[i]; j++) {
+         Double_t *out = &nevt[(fResFirst[i]+j)*nt];
+         for (Int_t it=0; it<nt; it++) out[it] += n[it]*k[j];
+      }
+   }
+   for (Int_t j=0; j<=npe; j++)
+      for (Int_t it=0; it<nt; it++)
+         hPE->SetBinContent(it+1, j+1, nevt[j*nt+it]);
+   return hPE;
+}
@@ -3,21 +3,66 @@
 
 #include "Detector.h"
 
+#include <vector>
+
+class TH1D;
+class TH2D;
+class TAxis;
+
 namespace CNNS { class ScintillationDetector; }
 
 class CNNS::ScintillationDetector : public CNNS::Detector
 {
    public:
       Double_t LightYield;
+      Double_t QuenchingSpread; // relative spread of the mean number of PE
+
+   protected:
+      Double_t fResLightYield; //! light yield used to build the response
+      Double_t fResSpread; //! quenching spread used to build the response
+      Int_t fResNPE; //! response covers 0 to fResNPE PE
+      std::vector<Double_t> fResEdges; //! recoil energy bin edges [keV]
+      std::vector<Int_t> fResFirst; //! first PE with non-zero probability
+      std::vector<Int_t> fResOffset; //! start of each row in fResK
+      std::vector<Double_t> fResK; //! non-zero probabilities, row by row
+
+      /**
+       * Sparse matrix of probabilities to see n PE for a recoil in each bin
+       * of axis, built only if light yield, spread or binning changed.
+       */
+      void BuildResponse(const TAxis *axis, Int_t npe);
+      Int_t DefaultNPE(const TAxis *axis);
 
    public:
-      ScintillationDetector() : Detector(), LightYield(0) {};
+      ScintillationDetector() : Detector(), LightYield(0),
+      QuenchingSpread(0), fResLightYield(0), fResSpread(0), fResNPE(0) {};
       ScintillationDetector(const char *name, const char *title) :
-         Detector(name, title), LightYield(0) {};
+         Detector(name, title), LightYield(0), QuenchingSpread(0),
+         fResLightYield(0), fResSpread(0), fResNPE(0) {};
 
       virtual ~ScintillationDetector() {};
 
-      ClassDef(ScintillationDetector,1);
+      /**
+       * Mean number of PE for a nuclear recoil of energy Enr. Without
+       * quenching it is simply LightYield*Enr.
+       */
+      virtual Double_t MeanPE(Double_t Enr) { return LightYield*Enr; }
+
+      /**
+       * Spectrum in number of PE from a spectrum h in recoil energy [keV],
+       * e.g. SupernovaExperiment::HNevtE. Each recoil energy bin is spread
+       * with Poisson photo-statistics around MeanPE at its center, convolved
+       * with a Gaussian of relative width QuenchingSpread. The result has
+       * one bin per PE from 0 to npe; npe=0 chooses it from the last bin.
+       */
+      TH1D* Smear(const TH1D *h, Int_t npe=0);
+      /**
+       * The same as above for each time bin of h, e.g.
+       * SupernovaExperiment::HNevt2, with recoil energy on the y axis.
+       */
+      TH2D* Smear(const TH2D *h, Int_t npe=0);
+
+      ClassDef(ScintillationDetector,2);
 };
 
 #endif
@@ -0,0 +1,127 @@
+#include "Detector.h"
+#include "Snapshot.h"
+using namespace CNNS;
+
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TAxis.h>
+
+ClassImp(Snapshot)
+
+//______________________________________________________________________________
+//
+
+Snapshot::Snapshot(const char *name, const char *title, UShort_t type,
+      Double_t distance, Double_t targetMass, Double_t threshold,
+      const TH1D *nevtE, const TH1D *nevtT, const TH1D *detectableT,
+      const TH2D *nevt2, Long64_t nevaluations) : TNamed(name, title),
+   fType(type), fDistance(distance), fTargetMass(targetMass),
+   fThreshold(threshold), fNevaluations(nevaluations)
+{
+   fHNevtE = (TH1D*) nevtE->Clone(Form("%sE", name));
+   fHNevtT = (TH1D*) nevtT->Clone(Form("%sT", name));
+   fHDetectableT = (TH1D*) detectableT->Clone(Form("%sDetectableT", name));
+   fHNevt2 = (TH2D*) nevt2->Clone(Form("%s2", name));
+   fHNevtE->SetDirectory(0);
+   fHNevtT->SetDirectory(0);
+   fHDetectableT->SetDirectory(0);
+   fHNevt2->SetDirectory(0);
+
+   Int_t n = fHNevtE->GetNbinsX();
+   fCumE.assign(n+1, 0);
+   for (Int_t i=1; i<=n; i++)
+      fCumE[i] = fCumE[i-1]
+         + fHNevtE->GetBinContent(i)*fHNevtE->GetBinWidth(i);
+}
+
+//______________________________________________________________________________
+//
+
+Snapshot::~Snapshot()
+{
+   if (fHNevtE) delete fHNevtE;
+   if (fHNevtT) delete fHNevtT;
+   if (fHDetectableT) delete fHDetectableT;
+   if (fHNevt2) delete fHNevt2;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::NevtE(Double_t Enr) const
+{
+   Int_t bin = fHNevtE->GetXaxis()->FindFixBin(Enr/keV);
+   if (bin<1 || bin>fHNevtE->GetNbinsX()) return 0;
+   return fHNevtE->GetBinContent(bin);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::Nevt2(Double_t time, Double_t Enr) const
+{
+   Int_t ix = fHNevt2->GetXaxis()->FindFixBin(time/sec);
+   Int_t iy = fHNevt2->GetYaxis()->FindFixBin(Enr/keV);
+   if (ix<1 || ix>fHNevt2->GetNbinsX() || iy<1 || iy>fHNevt2->GetNbinsY())
+      return 0;
+   return fHNevt2->GetBinContent(ix, iy);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::Nevt() const
+{
+   return fCumE.back();
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::Nevt(Double_t minEr) const
+{
+   // bins with lower edges above minEr, found by binary search
+   const Double_t *edges = fHNevtE->GetXaxis()->GetXbins()->GetArray();
+   Int_t n = fHNevtE->GetNbinsX(), low=0, high=n;
+   while (low<high) {
+      Int_t mid = (low+high)/2;
+      if (edges[mid]*keV<minEr) low=mid+1;
+      else high=mid;
+   }
+   return fCumE[n]-fCumE[low];
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::Ndetectable() const
+{
+   Double_t sum=0;
+   for (Int_t i=1; i<=fHDetectableT->GetNbinsX(); i++)
+      sum += fHDetectableT->GetBinContent(i)*fHDetectableT->GetBinWidth(i);
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t Snapshot::Nevt(Double_t tmin, Double_t tmax, Double_t minEr,
+      Double_t maxEr) const
+{
+   TAxis *taxis = fHNevt2->GetXaxis(), *eaxis = fHNevt2->GetYaxis();
+   Double_t t1=tmin/sec, t2=tmax/sec, e1=minEr/keV, e2=maxEr/keV;
+   Double_t sum=0;
+   for (Int_t ix=1; ix<=taxis->GetNbins(); ix++) {
+      Double_t lo = taxis->GetBinLowEdge(ix), up = taxis->GetBinUpEdge(ix);
+      Double_t dt = (up<t2?up:t2) - (lo>t1?lo:t1);
+      if (dt<=0) continue;
+      for (Int_t iy=1; iy<=eaxis->GetNbins(); iy++) {
+         lo = eaxis->GetBinLowEdge(iy);
+         up = eaxis->GetBinUpEdge(iy);
+         Double_t de = (up<e2?up:e2) - (lo>e1?lo:e1);
+         if (de<=0) continue;
+         sum += fHNevt2->GetBinContent(ix, iy)*dt*de;
+      }
+   }
+   return sum;
+}
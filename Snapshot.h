@@ -0,0 +1,83 @@
+#ifndef CNNS_SNAPSHOT_H
+#define CNNS_SNAPSHOT_H
+
+#include <TNamed.h>
+
+#include <vector>
+#include <memory>
+
+class TH1D;
+class TH2D;
+
+namespace CNNS { class Snapshot; }
+
+/**
+ * Results of a SupernovaExperiment for one type of neutrinos frozen at the
+ * time it is taken: Nevt(Enr), Nevt(t), detectable Nevt(t) and Nevt(t, Enr)
+ * with the distance, target mass and threshold they were scaled to. It is
+ * never changed after construction, so it can be read from several threads
+ * at the same time and shared with std::shared_ptr instead of cloning the
+ * histograms of the experiment, which are replaced by its next setter.
+ * All methods are const and reentrant.
+ */
+class CNNS::Snapshot : public TNamed
+{
+   protected:
+      UShort_t fType; // type of neutrinos
+      Double_t fDistance; // distance to supernova
+      Double_t fTargetMass; // target mass of detector
+      Double_t fThreshold; // energy threshold of detector
+      Long64_t fNevaluations; // integrand evaluations spent on the results
+      TH1D *fHNevtE; // Nevt(Enr) [1/keV] above threshold
+      TH1D *fHNevtT; // Nevt(t) [1/second] above threshold
+      TH1D *fHDetectableT; // Nevt(t) weighted by efficiency
+      TH2D *fHNevt2; // Nevt(t, Enr) [1/keV/second] above threshold
+      std::vector<Double_t> fCumE; // sum of fHNevtE*width up to a bin
+
+      Snapshot(const Snapshot&); // not copyable
+      Snapshot& operator=(const Snapshot&);
+
+   public:
+      Snapshot() : TNamed(), fType(0), fDistance(0), fTargetMass(0),
+      fThreshold(0), fNevaluations(0), fHNevtE(0), fHNevtT(0),
+      fHDetectableT(0), fHNevt2(0) {};
+      /**
+       * Copy the histograms, which are not needed afterwards.
+       */
+      Snapshot(const char *name, const char *title, UShort_t type,
+            Double_t distance, Double_t targetMass, Double_t threshold,
+            const TH1D *nevtE, const TH1D *nevtT, const TH1D *detectableT,
+            const TH2D *nevt2, Long64_t nevaluations=0);
+      virtual ~Snapshot();
+
+      UShort_t Type() const { return fType; }
+      Double_t Distance() const { return fDistance; }
+      Double_t TargetMass() const { return fTargetMass; }
+      Double_t Threshold() const { return fThreshold; }
+      Long64_t Nevaluations() const { return fNevaluations; }
+      const TH1D* HNevtE() const { return fHNevtE; }
+      const TH1D* HNevtT() const { return fHNevtT; }
+      const TH1D* HDetectableT() const { return fHDetectableT; }
+      const TH2D* HNevt2() const { return fHNevt2; }
+
+      Double_t NevtE(Double_t Enr) const; // in the bin of Enr
+      Double_t Nevt2(Double_t time, Double_t Enr) const; // in the bin
+      Double_t Nevt() const; // total number of events above threshold
+      Double_t Nevt(Double_t minEr) const; // in bins above minEr
+      Double_t Ndetectable() const; // events weighted by efficiency
+      /**
+       * Number of events between tmin and tmax with recoil energies
+       * between minEr and maxEr, taking fractions of partially covered
+       * bins of Nevt(t, Enr).
+       */
+      Double_t Nevt(Double_t tmin, Double_t tmax, Double_t minEr,
+            Double_t maxEr) const;
+
+      ClassDef(Snapshot,1);
+};
+
+namespace CNNS {
+   typedef std::shared_ptr<const Snapshot> SnapshotPtr;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include "Stats.h"
+using namespace CNNS;
+
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+   std::mutex gMutex;
+   Stats gEnded; // counters of threads that have ended
+   TString gFile; // JSON output at exit
+
+   // counters of one thread, added to gEnded when the thread ends
+   struct Local {
+      Stats stats;
+      ~Local() {
+         std::lock_guard<std::mutex> lock(gMutex);
+         gEnded += stats;
+      }
+   };
+   thread_local Local gLocal;
+
+   void Dump()
+   {
+      // thread local counters of the main thread are already in gEnded
+      std::lock_guard<std::mutex> lock(gMutex);
+      FILE *file = fopen(gFile.Data(), "w");
+      if (!file) return;
+      fprintf(file, "%s\n", gEnded.JSON().Data());
+      fclose(file);
+   }
+
+   // CNNS_STATS_JSON is checked when the library is loaded
+   struct Environment {
+      Environment() {
+         const char *file = getenv("CNNS_STATS_JSON");
+         if (file && file[0]) DumpStatsAtExit(file);
+      }
+   } gEnvironment;
+}
+
+//______________________________________________________________________________
+//
+
+Stats& CNNS::ThreadStats()
+{
+   return gLocal.stats;
+}
+
+//______________________________________________________________________________
+//
+
+Stats CNNS::GlobalStats()
+{
+   std::lock_guard<std::mutex> lock(gMutex);
+   Stats stats = gEnded;
+   stats += gLocal.stats;
+   return stats;
+}
+
+//______________________________________________________________________________
+//
+
+void CNNS::ResetStats()
+{
+   std::lock_guard<std::mutex> lock(gMutex);
+   gEnded.Reset();
+   gLocal.stats.Reset();
+}
+
+//______________________________________________________________________________
+//
+
+void CNNS::DumpStatsAtExit(const char *file)
+{
+   std::lock_guard<std::mutex> lock(gMutex);
+   if (gFile.IsNull()) std::atexit(Dump);
+   gFile = file;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t CNNS::StatsClock()
+{
+   return std::chrono::duration<Double_t>(
+         std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//______________________________________________________________________________
+//
+
+void Stats::Reset()
+{
+   Fluxes=Integrals=Fills=FillIntegrals=0;
+   XSTime=FluxTime=FillTime=0;
+   ViewHits=ViewMisses=UnitHits=UnitMisses=0;
+   MemoryHits=MemoryMisses=FileHits=FileMisses=0;
+}
+
+//______________________________________________________________________________
+//
+
+Stats& Stats::operator+=(const Stats &other)
+{
+   Fluxes += other.Fluxes;
+   XSTime += other.XSTime;
+   FluxTime += other.FluxTime;
+   Integrals += other.Integrals;
+   Fills += other.Fills;
+   FillIntegrals += other.FillIntegrals;
+   FillTime += other.FillTime;
+   ViewHits += other.ViewHits;
+   ViewMisses += other.ViewMisses;
+   UnitHits += other.UnitHits;
+   UnitMisses += other.UnitMisses;
+   MemoryHits += other.MemoryHits;
+   MemoryMisses += other.MemoryMisses;
+   FileHits += other.FileHits;
+   FileMisses += other.FileMisses;
+   return *this;
+}
+
+//______________________________________________________________________________
+//
+
+TString Stats::JSON() const
+{
+   return Form("{\"fluxes\": %lld, "
+         "\"xs_seconds\": %.6f, \"flux_seconds\": %.6f, "
+         "\"integrals\": %lld, \"fills\": %lld, \"fill_integrals\": %lld, "
+         "\"fill_seconds\": %.6f, \"view_hits\": %lld, \"view_misses\": %lld, "
+         "\"unit_hits\": %lld, \"unit_misses\": %lld, "
+         "\"memory_hits\": %lld, \"memory_misses\": %lld, "
+         "\"file_hits\": %lld, \"file_misses\": %lld}",
+         Fluxes, XSTime, FluxTime, Integrals, Fills,
+         FillIntegrals, FillTime, ViewHits, ViewMisses, UnitHits, UnitMisses,
+         MemoryHits, MemoryMisses, FileHits, FileMisses);
+}
+
+//______________________________________________________________________________
+//
+
+void Stats::Print() const
+{
+   std::cout<<"flux calls:        "<<Fluxes<<std::endl;
+   std::cout<<"time in dXS:       "<<XSTime<<" s (sampled)"<<std::endl;
+   std::cout<<"time in flux:      "<<FluxTime<<" s (sampled)"<<std::endl;
+   std::cout<<"integrals:         "<<Integrals<<std::endl;
+   std::cout<<"histograms filled: "<<Fills<<" with "<<FillIntegrals
+      <<" integrals in "<<FillTime<<" s"<<std::endl;
+   std::cout<<"view hits/misses:  "<<ViewHits<<"/"<<ViewMisses<<std::endl;
+   std::cout<<"unit hits/misses:  "<<UnitHits<<"/"<<UnitMisses<<std::endl;
+   std::cout<<"memory hits/misses: "<<MemoryHits<<"/"<<MemoryMisses<<std::endl;
+   std::cout<<"file hits/misses:  "<<FileHits<<"/"<<FileMisses<<std::endl;
+}
@@ -0,0 +1,66 @@
+#ifndef CNNS_STATS_H
+#define CNNS_STATS_H
+
+#include <TString.h>
+
+namespace CNNS {
+   struct Stats;
+   /**
+    * Counters of the calling thread, updated without locks in hot paths.
+    */
+   Stats& ThreadStats();
+   /**
+    * Sum of the calling thread and of all threads that have ended.
+    */
+   Stats GlobalStats();
+   void ResetStats(); // of the calling thread and of ended threads
+   /**
+    * Write GlobalStats() as JSON to file at exit. It is also done if the
+    * environment variable CNNS_STATS_JSON is set to a file name.
+    */
+   void DumpStatsAtExit(const char *file);
+   Double_t StatsClock(); // wall clock in second
+}
+
+/**
+ * Instrumentation of SupernovaExperiment. All counters are removed at
+ * compile time with -DCNNS_NO_STATS, so that GlobalStats() stays zero.
+ */
+struct CNNS::Stats
+{
+   /**
+    * Only one integrand call out of fgSampling is timed, times of dXS and
+    * flux are multiplied by it.
+    */
+   static const Long64_t fgSampling=256;
+
+   Long64_t Fluxes; // calls of SupernovaModel::Ne or N2
+   Double_t XSTime; // estimated second in Element::CNNSdXS
+   Double_t FluxTime; // estimated second in SupernovaModel::Ne and N2
+   Long64_t Integrals; // integrals over neutrino energy
+   Long64_t Fills; // histograms filled by integration
+   Long64_t FillIntegrals; // integrals done to fill them
+   Double_t FillTime; // second spent to fill them
+   Long64_t ViewHits; // fHNevt2, fHNevtT, fHNevtE returned as they are
+   Long64_t ViewMisses; // ... created or rescaled
+   Long64_t UnitHits; // fHUnit2, fHUnitE already calculated
+   Long64_t UnitMisses; // ... read from a cache or filled
+   Long64_t MemoryHits; // histograms copied from ResultCache
+   Long64_t MemoryMisses; // ... not kept in it
+   Long64_t FileHits; // histograms read from CacheFile
+   Long64_t FileMisses; // ... not found in it
+
+   Stats() { Reset(); }
+   void Reset();
+   Stats& operator+=(const Stats &other);
+   TString JSON() const;
+   void Print() const;
+};
+
+#ifdef CNNS_NO_STATS
+#  define CNNS_STATS(statement)
+#else
+#  define CNNS_STATS(statement) statement
+#endif
+
+#endif
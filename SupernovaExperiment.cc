@@ -1,4 +1,7 @@
 #include "Detector.h"
+#include "XSTable.h"
+#include "ResponseMatrix.h"
+#include "FluxTable.h"
 #include "SupernovaExperiment.h"
 using namespace CNNS;
 
@@ -13,14 +16,86 @@ using namespace NEUS;
 #include <TH2D.h>
 #include <TAxis.h>
 #include <TMath.h>
+#include <TROOT.h>
+#include <TMD5.h>
+#include <TFile.h>
+#include <TSystem.h>
+#include <TParameter.h>
 using namespace TMath;
 
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+namespace {
+   // integrand evaluations of the calling thread
+   thread_local Long64_t gNeval=0;
+
+   // times dXS and flux in one integrand call out of Stats::fgSampling
+   class IntegrandTimer {
+      Bool_t fTimed;
+      Double_t fStart, fXS;
+      public:
+      IntegrandTimer() : fTimed(gNeval%Stats::fgSampling==0),
+      fStart(fTimed ? StatsClock() : 0), fXS(0) {}
+      void XSDone() { if (fTimed) fXS = StatsClock(); }
+      void FluxDone() {
+         if (!fTimed) return;
+         Stats &stats = ThreadStats();
+         stats.XSTime += (fXS-fStart)*Stats::fgSampling;
+         stats.FluxTime += (StatsClock()-fXS)*Stats::fgSampling;
+      }
+   };
+
+   // value saved in a cache file next to the histogram of key
+   template<typename T> void WriteParameter(TFile &file, const char *key,
+         const char *name, T value)
+   {
+      TParameter<T> p(name, value);
+      file.WriteTObject(&p, Form("%s_%s", key, name), "WriteDelete");
+   }
+
+   template<typename T> T ReadParameter(TFile &file, const char *key,
+         const char *name)
+   {
+      TParameter<T> *p =
+         dynamic_cast<TParameter<T>*>(file.Get(Form("%s_%s", key, name)));
+      T value = p ? p->GetVal() : 0;
+      delete p;
+      return value;
+   }
+
+   // advisory lock on file.lock while in scope, shared for reading and
+   // exclusive for writing; threads conflict as well as they open their own
+   // descriptors
+   class CacheLock {
+      int fFd;
+      CacheLock(const CacheLock&);
+      CacheLock& operator=(const CacheLock&);
+      public:
+      CacheLock(const char *file, bool exclusive) {
+         fFd = open((TString(file)+".lock").Data(), O_RDWR|O_CREAT, 0644);
+         if (fFd>=0) flock(fFd, exclusive ? LOCK_EX : LOCK_SH);
+      }
+      ~CacheLock() { if (fFd>=0) close(fFd); } // releases the lock
+   };
+}
+
 //______________________________________________________________________________
 //
 
 SupernovaExperiment::SupernovaExperiment(
       Detector *detector, SupernovaModel *model) : TNamed(),
-   Distance(0), fDetector(detector), fModel(model)
+   Distance(0), Nthreads(1), Integration(kAdaptive), GaussLegendreOrder(16),
+   Tolerance(1e-6), fDetector(detector),
+   fModel(model), fFlux(0), fXSTable(0), fResponse(0),
+   fResults(new ResultCache)
 {
    for (UShort_t i=0; i<SupernovaModel::fgNtype; i++) {
       fFXSxNe[i]=0;
@@ -28,7 +103,95 @@ SupernovaExperiment::SupernovaExperiment(
       fHNevt2[i]=0;
       fHNevtT[i]=0;
       fHNevtE[i]=0;
+      fHUnit2[i]=0;
+      fHUnitE[i]=0;
+      fScale2[i]=0;
+      fScaleT[i]=0;
+      fScaleE[i]=0;
+      fThreshold2[i]=0;
+      fThresholdE[i]=0;
+      fFluxTime[i]=0;
+      fFlavorWeight[i]=0;
+   }
+   // nu_e, anti-nu_e and 4 nu_x (nu_mu, nu_tau and their anti-particles)
+   fFlavorWeight[1]=1;
+   fFlavorWeight[2]=1;
+   fFlavorWeight[3]=4;
+}
+
+//______________________________________________________________________________
+//
+
+SupernovaExperiment::~SupernovaExperiment()
+{
+   Clear();
+   if (fXSTable) delete fXSTable;
+   if (fResponse) delete fResponse;
+   for (std::map<TString, XSTable*>::iterator it=fKernels.begin();
+         it!=fKernels.end(); it++) delete it->second;
+   delete fResults;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::SetDetector(Detector *detector)
+{
+   // results per kg of the same target only need to be scaled, cut and
+   // folded with the new efficiency; otherwise they come back from
+   // fResults by CacheKey, and fXSTable is rebuilt by CrossSectionTable()
+   // only for another target composition
+   Bool_t same = SameTarget(detector);
+   for (UShort_t i=0; i<SupernovaModel::fgNtype; i++)
+      if (same) ClearViews(i);
+      else ClearType(i);
+   fDetector = detector;
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t SupernovaExperiment::SameTarget(const Detector *detector)
+{
+   if (!fDetector || !detector) return kFALSE;
+   Material *m1 = fDetector->TargetMaterial, *m2 = detector->TargetMaterial;
+   if (m1==m2) return m1!=0;
+   if (!m1 || !m2 || m1->Nelements()!=m2->Nelements()
+         || TString(m1->GetName())!=m2->GetName()) return kFALSE;
+   for (UShort_t i=0; i<m1->Nelements(); i++) {
+      Element *e1 = m1->GetElement(i), *e2 = m2->GetElement(i);
+      if (TString(e1->GetName())!=e2->GetName() || e1->A()!=e2->A()
+            || e1->M()!=e2->M()
+            || m1->Natoms(i)*m2->Natoms(0)!=m2->Natoms(i)*m1->Natoms(0))
+         return kFALSE;
+   }
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+std::vector<SnapshotPtr> SupernovaExperiment::Evaluate(UShort_t type,
+      const std::vector<Detector*> &detectors)
+{
+   std::vector<SnapshotPtr> snapshots(detectors.size());
+   std::vector<Bool_t> done(detectors.size(), kFALSE);
+   Detector *current = fDetector;
+   // detectors are taken in groups of the same target, so that switching
+   // between them only clears views; the unit results of a target are
+   // integrated, or taken back from Results(), once per group
+   for (size_t i=0; i<detectors.size(); i++) {
+      if (done[i]) continue;
+      SetDetector(detectors[i]);
+      for (size_t j=i; j<detectors.size(); j++) {
+         if (done[j] || (j>i && !SameTarget(detectors[j]))) continue;
+         SetDetector(detectors[j]);
+         snapshots[j] = TakeSnapshot(type);
+         done[j] = kTRUE;
+      }
    }
+   SetDetector(current);
+   return snapshots;
 }
 
 //______________________________________________________________________________
@@ -40,13 +203,13 @@ Double_t SupernovaExperiment::XSxNe(Double_t *x, Double_t *parameter)
    Double_t Er = parameter[0]; // nuclear recoil energy
    UShort_t type = static_cast<UShort_t>(parameter[1]); // type of neutrino
 
-   Element *element = fDetector->TargetMaterial->GetElement();
-   Double_t dXS = element->CNNSdXS(Er*keV, Ev*MeV);
-
-   if (type==0)
-      return dXS*(fModel->Ne(1,Ev) + fModel->Ne(2,Ev) + 4*fModel->Ne(3,Ev))/MeV;
-
-   return dXS * fModel->Ne(type,Ev)/MeV;
+   CNNS_STATS(IntegrandTimer timer);
+   gNeval++;
+   Double_t dXS = TargetdXS(Er*keV, Ev*MeV);
+   CNNS_STATS(timer.XSDone());
+   Double_t flux = Ne(type,Ev);
+   CNNS_STATS(timer.FluxDone());
+   return dXS * flux/MeV;
 }
 
 //______________________________________________________________________________
@@ -59,232 +222,230 @@ Double_t SupernovaExperiment::XSxN2(Double_t *x, Double_t *parameter)
    UShort_t type = static_cast<UShort_t>(parameter[1]); // type of neutrino
    Double_t time = parameter[2];
 
-   Element *element = fDetector->TargetMaterial->GetElement();
-   Double_t dXS = element->CNNSdXS(Er*keV, Ev*MeV);
+   CNNS_STATS(IntegrandTimer timer);
+   gNeval++;
+   Double_t dXS = TargetdXS(Er*keV, Ev*MeV);
+   CNNS_STATS(timer.XSDone());
+   Double_t flux = N2(type,time,Ev);
+   CNNS_STATS(timer.FluxDone());
+   return dXS * flux/sec/MeV;
+}
+
+//______________________________________________________________________________
+//
 
-   if (type==0)
-      return dXS*(fModel->N2(1,time,Ev) + fModel->N2(2,time,Ev)
-            + 4*fModel->N2(3,time,Ev))/sec/MeV;
+Double_t SupernovaExperiment::Ne(UShort_t type, Double_t Ev) const
+{
+   if (type!=0) {
+      CNNS_STATS(ThreadStats().Fluxes++);
+      return fFlux ? fFlux->Ne(type,Ev) : fModel->Ne(type,Ev);
+   }
 
-   return dXS * fModel->N2(type,time,Ev)/sec/MeV;
+   Double_t sum=0;
+   for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+      if (fFlavorWeight[i]==0) continue;
+      CNNS_STATS(ThreadStats().Fluxes++);
+      sum += fFlavorWeight[i]*(fFlux ? fFlux->Ne(i,Ev) : fModel->Ne(i,Ev));
+   }
+   return sum;
 }
 
 //______________________________________________________________________________
 //
 
-Double_t SupernovaExperiment::NevtE(UShort_t type, Double_t Enr)
+Double_t SupernovaExperiment::N2(UShort_t type, Double_t time, Double_t Ev) const
 {
-   if (!fDetector->TargetMaterial) {
-      Warning("NevtE", "Please set targe material!");
-      return 0;
+   if (type!=0) {
+      CNNS_STATS(ThreadStats().Fluxes++);
+      return fFlux ? fFlux->N2(type,time,Ev) : fModel->N2(type,time,Ev);
    }
-   if (fDetector->TargetMaterial->Nelements()!=1) {
-      Warning("NevtE", "Can only handle material with one element!");
-      return 0;
+
+   Double_t sum=0;
+   for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+      if (fFlavorWeight[i]==0) continue;
+      CNNS_STATS(ThreadStats().Fluxes++);
+      sum += fFlavorWeight[i]
+         *(fFlux ? fFlux->N2(i,time,Ev) : fModel->N2(i,time,Ev));
    }
-   if (!fModel) {
-      Warning("NevtE", "Please set supernova model!");
-      return 0;
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::SetFlavorWeight(UShort_t type, Double_t weight)
+{
+   if (type<1 || type>6) {
+      Warning("SetFlavorWeight","Type of neutrinos must be in 1, 2, 3, 4, 5, 6!");
+      return;
    }
+   if (fFlavorWeight[type]==weight) return;
+   fFlavorWeight[type]=weight;
 
-   Element *element = fDetector->TargetMaterial->GetElement();
-   Double_t atomicMass  = element->A();
-   Double_t nNuclei = fDetector->TargetMass/atomicMass*Avogadro;
-   Double_t area = 4*pi*Distance/hbarc*Distance/hbarc;
+   ClearType(0); // only the sum of all flavors depends on the weights
+}
 
-   Double_t detectableEv = (Enr + Sqrt(2*element->M()*Enr))/2;
-   Double_t minEv = fModel->EMin();
-   minEv = minEv>detectableEv?minEv*MeV:detectableEv*MeV;
-   Double_t maxEv = fModel->EMax()*MeV;
+//______________________________________________________________________________
+//
 
-   TF1 *f = FXSxNe(type,Enr/keV);
-   return nNuclei/area*1e50*f->Integral(minEv/MeV, maxEv/MeV)*keV;
+Double_t SupernovaExperiment::EMin() const
+{
+   return fFlux ? fFlux->EMin() : fModel->EMin();
 }
 
 //______________________________________________________________________________
 //
 
-Double_t SupernovaExperiment::Nevt2(UShort_t type, Double_t time, Double_t Enr)
+Double_t SupernovaExperiment::EMax() const
 {
-   if (!fDetector->TargetMaterial) {
-      Warning("Nevt2", "Please set targe material!");
-      return 0;
-   }
-   if (fDetector->TargetMaterial->Nelements()!=1) {
-      Warning("Nevt2", "Can only handle material with one element!");
-      return 0;
-   }
-   if (!fModel) {
-      Warning("Nevt2", "Please set supernova model!");
-      return 0;
-   }
+   return fFlux ? fFlux->EMax() : fModel->EMax();
+}
 
-   Element *element = fDetector->TargetMaterial->GetElement();
-   Double_t atomicMass  = element->A();
-   Double_t nNuclei = fDetector->TargetMass/atomicMass*Avogadro;
-   Double_t area = 4*pi*Distance/hbarc*Distance/hbarc;
+//______________________________________________________________________________
+//
 
-   Double_t maxEv = fModel->EMax()*MeV; // max neutrino energy
-   Double_t minEv = (Enr + Sqrt(2*element->M()*Enr))/2;
-   if (minEv<fModel->EMin()*MeV) {
-      Warning("Nevt2","Requested neutrino energy is too small.");
-      Warning("Nevt2","Reset it to the minimal energy provided by NEUS.");
-      minEv=fModel->EMin()*MeV;
+const Double_t* SupernovaExperiment::TimeBins(Int_t &n)
+{
+   if (fFlux) {
+      n = fFlux->Nt();
+      return fFlux->TimeBins();
    }
+   n = fModel->HN2()->GetXaxis()->GetNbins();
+   return fModel->HN2()->GetXaxis()->GetXbins()->GetArray();
+}
 
-   TF1 *f = FXSxN2(type,time/sec,Enr/keV);
-   return nNuclei/area*1e50*f->Integral(minEv/MeV, maxEv/MeV)*keV*sec;
+//______________________________________________________________________________
+//
+
+const TNamed* SupernovaExperiment::Source()
+{
+   if (fFlux) return fFlux;
+   return fModel;
 }
 
 //______________________________________________________________________________
 //
 
-TF1* SupernovaExperiment::FXSxNe(UShort_t type, Double_t Enr)
+Bool_t SupernovaExperiment::CanEvaluate(const char *method) const
 {
-   if (fFXSxNe[type]) {
-      fFXSxNe[type]->SetParameter(0,Enr);
-      return fFXSxNe[type];
+   if (!fDetector->TargetMaterial) {
+      Warning(method, "Please set targe material!");
+      return kFALSE;
+   }
+   if (fDetector->TargetMaterial->Nelements()==0) {
+      Warning(method, "Please add elements to target material!");
+      return kFALSE;
    }
+   if (!fModel && !fFlux) {
+      Warning(method, "Please set supernova model or flux table!");
+      return kFALSE;
+   }
+   return kTRUE;
+}
 
-   fFXSxNe[type] = new TF1(Form("fFXSxNe%s%s%f%d", fModel->GetName(),
-            fDetector->TargetMaterial->GetName(), fDetector->TargetMass,
-            type), this, &SupernovaExperiment::XSxNe, 0., fModel->EMax(),2);
-   fFXSxNe[type]->SetParameter(0,Enr);
-   fFXSxNe[type]->SetParameter(1,type);
+//______________________________________________________________________________
+//
 
-   if (type==0) {
-      fFXSxNe[type]->SetTitle(Form(
-               "%s, target: %s, recoil energy: %.1f keV;neutrino energy [MeV];1/MeV^{4}", 
-               fModel->GetName(), fDetector->TargetMaterial->GetTitle(), Enr));
-      fFXSxNe[type]->SetLineColor(kGray+2);
-      fFXSxNe[type]->SetLineWidth(2);
-   } else {
-      fFXSxNe[type]->SetTitle(Form(
-               "neutrino %d from %s, target: %s;neutrino energy [MeV];1/MeV^{4}", 
-               type,fModel->GetName(),fDetector->TargetMaterial->GetTitle()));
-      fFXSxNe[type]->SetLineColor(type);
-   }
-   return fFXSxNe[type];
+Bool_t SupernovaExperiment::CanCalculate(const char *method)
+{
+   if (!CanEvaluate(method)) return kFALSE;
+
+   // once per calculation, before any worker calls TargetdXS
+   Material *material = fDetector->TargetMaterial;
+   Double_t natoms=0;
+   for (UShort_t i=0; i<material->Nelements(); i++)
+      natoms += material->Natoms(i);
+   fAbundance.resize(material->Nelements());
+   for (UShort_t i=0; i<material->Nelements(); i++)
+      fAbundance[i] = material->Natoms(i)/natoms;
+   return kTRUE;
 }
 
 //______________________________________________________________________________
 //
 
-TF1* SupernovaExperiment::FXSxN2(UShort_t type, Double_t time, Double_t Enr)
+Double_t SupernovaExperiment::Normalization() const
 {
-   if (fFXSxN2[type]) {
-      fFXSxN2[type]->SetParameter(0,Enr);
-      fFXSxN2[type]->SetParameter(2,time);
-      return fFXSxN2[type];
+   Material *material = fDetector->TargetMaterial;
+   Double_t natoms=0, molarMass=0; // per molecule
+   for (UShort_t i=0; i<material->Nelements(); i++) {
+      natoms += material->Natoms(i);
+      molarMass += material->Natoms(i)*material->GetElement(i)->A();
    }
+   Double_t nNuclei = kg/molarMass*natoms*Avogadro;
+   Double_t area = 4*pi*kpc/hbarc*kpc/hbarc;
+   return nNuclei/area*1e50;
+}
 
-   fFXSxN2[type] = new TF1(Form("fFXSxN2%s%s%f%d", fModel->GetName(),
-            fDetector->TargetMaterial->GetName(), fDetector->TargetMass,
-            type), this, &SupernovaExperiment::XSxN2, 0., fModel->EMax(),3);
-   fFXSxN2[type]->SetParameter(0,Enr);
-   fFXSxN2[type]->SetParameter(1,type);
-   fFXSxN2[type]->SetParameter(2,time);
+//______________________________________________________________________________
+//
 
-   if (type==0) {
-      fFXSxN2[type]->SetTitle(Form(
-               "%s, target: %s, recoil energy: %.1f keV, time: %.1f second;neutrino energy [MeV];1/MeV^{4}", 
-               fModel->GetName(), 
-               fDetector->TargetMaterial->GetTitle(), Enr, time));
-      fFXSxN2[type]->SetLineColor(kGray+2);
-      fFXSxN2[type]->SetLineWidth(2);
-   } else {
-      fFXSxN2[type]->SetTitle(Form(
-               "neutrino %d from %s, target: %s, recoil energy : %.1f, time: %.1f second;neutrino energy [MeV];1/MeV^{4}", 
-               type, fModel->GetName(), 
-               fDetector->TargetMaterial->GetTitle(), Enr, time));
-      fFXSxN2[type]->SetLineColor(type);
-   }
-   return fFXSxN2[type];
+Double_t SupernovaExperiment::Abundance(UShort_t i) const
+{
+   Material *material = fDetector->TargetMaterial;
+   Double_t natoms=0;
+   for (UShort_t j=0; j<material->Nelements(); j++)
+      natoms += material->Natoms(j);
+   return material->Natoms(i)/natoms;
 }
 
 //______________________________________________________________________________
 //
 
-Double_t SupernovaExperiment::Nevt()
+TString SupernovaExperiment::ElementKey(Element *element)
 {
-   TH1D* h = HNevtE(0);
-   Double_t minEr = fDetector->EnergyThreshold;
-   Int_t startBin=0, endBin=0;
-   for (Int_t i=1; i<=h->GetNbinsX(); i++) {
-      startBin=i;
-      if (h->GetBinLowEdge(i)*keV>=minEr) break;
-   }
-   for (Int_t i=1; i<=h->GetNbinsX(); i++) {
-      endBin=i;
-   }
-   return h->Integral(startBin,endBin,"width");
+   return Form("%s|%.17g|%.17g", element->GetName(), element->A(),
+         element->M());
 }
 
 //______________________________________________________________________________
 //
 
-TH1D* SupernovaExperiment::HXSxNe(UShort_t type, Double_t Enr)
+Double_t SupernovaExperiment::TargetdXS(Double_t Er, Double_t Ev) const
 {
-   if (type>6) {
-      Warning("HXSxNe","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
-      Warning("HXSxNe","Return NULL pointer!");
-      return 0;
+   Material *material = fDetector->TargetMaterial;
+   if (material->Nelements()==1)
+      return material->GetElement()->CNNSdXS(Er, Ev);
+
+   // fAbundance is set by CanCalculate, unless called from outside
+   Bool_t kept = fAbundance.size()==material->Nelements();
+   Double_t dXS=0;
+   for (UShort_t i=0; i<material->Nelements(); i++) {
+      Element *element = material->GetElement(i);
+      if (Ev<(Er + Sqrt(2*element->M()*Er))/2) continue; // forbidden
+      dXS += (kept ? fAbundance[i] : Abundance(i))*element->CNNSdXS(Er, Ev);
    }
-   TH1D *h = (TH1D*) FXSxNe(type, Enr/keV)->GetHistogram();
-   return h;
+   return dXS;
 }
 
 //______________________________________________________________________________
 //
 
-void SupernovaExperiment::Clear(Option_t *option)
+Double_t SupernovaExperiment::DetectableEv(Double_t Enr) const
 {
-   for (UShort_t i=0; i<SupernovaModel::fgNtype; i++) {
-      if (fFXSxNe[i]) {
-         delete fFXSxNe[i];
-         fFXSxNe[i]=NULL;
-      }
-      if (fFXSxN2[i]) {
-         delete fFXSxN2[i];
-         fFXSxN2[i]=NULL;
-      }
-      if (fHNevt2[i]) {
-         delete fHNevt2[i];
-         fHNevt2[i]=NULL;
-      }
-      if (fHNevtT[i]) {
-         delete fHNevtT[i];
-         fHNevtT[i]=NULL;
-      }
-      if (fHNevtE[i]) {
-         delete fHNevtE[i];
-         fHNevtE[i]=NULL;
-      }
-   }
+   Material *material = fDetector->TargetMaterial;
+   Double_t minM = material->GetElement()->M();
+   for (UShort_t i=1; i<material->Nelements(); i++)
+      if (material->GetElement(i)->M()<minM)
+         minM = material->GetElement(i)->M();
+   return (Enr + Sqrt(2*minM*Enr))/2;
 }
 
 //______________________________________________________________________________
 //
 
-TH2D* SupernovaExperiment::HNevt2(UShort_t type)
+Double_t SupernovaExperiment::Scale() const
 {
-   if (type>6) {
-      Warning("HNevt2","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
-      Warning("HNevt2","Return NULL pointer!");
-      return 0;
-   }
+   return fDetector->TargetMass/kg*(kpc/Distance)*(kpc/Distance);
+}
 
-   TString name = Form("hNevt2-%d-%f", type, fDetector->EnergyThreshold);
-   if (fHNevt2[type]) {
-      if (name.CompareTo(fHNevt2[type]->GetName())==0) return fHNevt2[type];
-      else delete fHNevt2[type];
-   }
+//______________________________________________________________________________
+//
 
-   // define bins
-   Int_t nbinst=fModel->HN2()->GetXaxis()->GetNbins();
-   const Double_t *tbins = fModel->HN2()->GetXaxis()->GetXbins()->GetArray();
+Int_t SupernovaExperiment::RecoilBins(Double_t *ebins)
+{
    Int_t nbinse=0;
-   Double_t e=0, de, ebins[200];
+   Double_t e=0, de;
    while (e<50.) {
       if (e<4.9999) de=0.1;
       else if (e<9.9999) de=0.25;
@@ -295,129 +456,1868 @@ TH2D* SupernovaExperiment::HNevt2(UShort_t type)
       e+=de;
    }
    ebins[nbinse]=e;
+   return nbinse;
+}
 
-   // create histogram
-   Double_t minEr = fDetector->EnergyThreshold;
-   //Info("HNevt2","Create HNevt2-%d with threshold %.3f keVnr",type,minEr/keV);
-   fHNevt2[type] = new TH2D(name.Data(),"",nbinst,tbins,nbinse,ebins);
-
-   // fill histogram
-   for (Int_t ix=1; ix<=fHNevt2[type]->GetNbinsX(); ix++) {
-      for (Int_t iy=1; iy<=fHNevt2[type]->GetNbinsY(); iy++) {
-         Double_t t = fHNevt2[type]->GetXaxis()->GetBinCenter(ix);
-         Double_t e = fHNevt2[type]->GetYaxis()->GetBinCenter(iy);
-         if (e*keV<minEr) continue; // skip events below threshold
-         Double_t nevt = Nevt2(type,t*sec,e*keV);
-         fHNevt2[type]->SetBinContent(ix, iy, nevt);
-      }
-   }
-   fHNevt2[type]->SetStats(0);
-   fHNevt2[type]->GetXaxis()->SetTitle("time [second]");
-   fHNevt2[type]->GetYaxis()->SetTitle("nuclear recoil energy [keV]");
-   fHNevt2[type]->SetTitle(Form("number of events / (%.0f kg)",
-            fDetector->TargetMass/kg));
+//______________________________________________________________________________
+//
 
-   return fHNevt2[type];
+Double_t SupernovaExperiment::NevtE(UShort_t type, Double_t Enr)
+{
+   if (!CanCalculate("NevtE")) return 0;
+   return Scale()*UnitNevtE(type, Enr);
 }
 
 //______________________________________________________________________________
 //
 
-TH1D* SupernovaExperiment::HNevtT(UShort_t type, Bool_t detectableOnly)
+Double_t SupernovaExperiment::UnitNevtE(UShort_t type, Double_t Enr,
+      Double_t *error, Long64_t *neval)
 {
-   TH2D *h = HNevt2(type);
+   CNNS_STATS(ThreadStats().Integrals++);
+   if (Integration==kTabulated) return TabulateNe(type, Enr, error, neval);
+   if (Integration==kMoments) return MomentNe(type, Enr);
+   if (Integration==kResponse) return ResponseNe(type, Enr);
+   if (Integration==kGaussLegendre) GaussLegendreNodes();
+   return IntegrateNe(FXSxNe(type,Enr/keV), Enr, error, neval);
+}
 
-   TString name = Form("hNevtT-%d-%f-%d", 
-         type, fDetector->EnergyThreshold, detectableOnly);
-   if (fHNevtT[type]) {
-      if (name.CompareTo(fHNevtT[type]->GetName())==0) return fHNevtT[type];
-      else delete fHNevtT[type];
-   }
+//______________________________________________________________________________
+//
 
-   // create histogram
-   Int_t nbinst=h->GetXaxis()->GetNbins();
-   const Double_t *tbins = h->GetXaxis()->GetXbins()->GetArray();
-   fHNevtT[type] = new TH1D(name.Data(),"",nbinst,tbins);
+Double_t SupernovaExperiment::IntegrateNe(TF1 *f, Double_t Enr,
+      Double_t *error, Long64_t *neval)
+{
+   Double_t detectableEv = DetectableEv(Enr);
+   Double_t minEv = EMin();
+   minEv = minEv>detectableEv?minEv*MeV:detectableEv*MeV;
+   Double_t maxEv = EMax()*MeV;
 
-   // fill histogram
-   for (Int_t ix=1; ix<=fHNevtT[type]->GetNbinsX(); ix++) {
-      Double_t nevt=0;
-      for (Int_t iy=1; iy<=h->GetNbinsY(); iy++) {
-         Double_t dn = h->GetBinContent(ix,iy);
-         Double_t de = h->GetYaxis()->GetBinWidth(iy);
-         if (detectableOnly) nevt+=dn*de*fDetector->Efficiency(
-               h->GetYaxis()->GetBinCenter(iy)*keV);
-         else nevt+=dn*de;
-      }
-      fHNevtT[type]->SetBinContent(ix, nevt);
+   f->SetParameter(0,Enr/keV);
+   Double_t norm = Normalization()*keV, err=0;
+   Double_t integral = Quadrature(f, minEv/MeV, maxEv/MeV, &err, neval);
+   if (error) *error += norm*err;
+   return norm*integral;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::Nevt2(UShort_t type, Double_t time, Double_t Enr)
+{
+   if (!CanCalculate("Nevt2")) return 0;
+   return Scale()*UnitNevt2(type, time, Enr);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::UnitNevt2(UShort_t type, Double_t time,
+      Double_t Enr, Double_t *error, Long64_t *neval)
+{
+   CNNS_STATS(ThreadStats().Integrals++);
+   if (Integration==kTabulated)
+      return TabulateN2(type, time, Enr, error, neval);
+   if (Integration==kMoments) return MomentN2(type, time, Enr);
+   if (Integration==kResponse) return ResponseN2(type, time, Enr);
+   if (Integration==kGaussLegendre) GaussLegendreNodes();
+   return IntegrateN2(FXSxN2(type,time/sec,Enr/keV), time, Enr, error, neval);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::IntegrateN2(TF1 *f, Double_t time, Double_t Enr,
+      Double_t *error, Long64_t *neval)
+{
+   Double_t maxEv = EMax()*MeV; // max neutrino energy
+   Double_t minEv = DetectableEv(Enr);
+   if (minEv<EMin()*MeV) {
+      Warning("Nevt2","Requested neutrino energy is too small.");
+      Warning("Nevt2","Reset it to the minimal energy provided by NEUS.");
+      minEv=EMin()*MeV;
    }
-   fHNevtT[type]->SetStats(0);
-   fHNevtT[type]->SetTitle(Form("%s",fModel->GetTitle()));
-   fHNevtT[type]->SetXTitle("time [second]");
-   fHNevtT[type]->SetYTitle(Form("rate of events [Hz/(%.0f kg)]",
-            fDetector->TargetMass/kg));
-   fHNevtT[type]->GetYaxis()->SetTitleOffset(1.3);
 
-   return fHNevtT[type];
+   f->SetParameter(0,Enr/keV);
+   f->SetParameter(2,time/sec);
+   Double_t norm = Normalization()*keV*sec, err=0;
+   Double_t integral = Quadrature(f, minEv/MeV, maxEv/MeV, &err, neval);
+   if (error) *error += norm*err;
+   return norm*integral;
 }
 
 //______________________________________________________________________________
 //
 
-TH1D* SupernovaExperiment::HNevtE(UShort_t type, Bool_t refresh)
+Double_t SupernovaExperiment::EvaluateNevtE(UShort_t type, Double_t Enr) const
 {
    if (type>6) {
-      Warning("HNevtE","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
-      Warning("HNevtE","Return NULL pointer!");
+      Warning("EvaluateNevtE","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
       return 0;
    }
-   if (!fDetector->TargetMaterial) {
-      Warning("HNevtE", "Please set targe material!");
+   if (!CanEvaluate("EvaluateNevtE")) return 0;
+   return Scale()*EvaluateUnit(type, 0, Enr);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::EvaluateNevt2(UShort_t type, Double_t time,
+      Double_t Enr) const
+{
+   if (type>6) {
+      Warning("EvaluateNevt2","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
       return 0;
    }
+   if (!CanEvaluate("EvaluateNevt2")) return 0;
+   return Scale()*EvaluateUnit(type, &time, Enr);
+}
 
-   TString name = Form("hNevtE-%d-%f", type, fDetector->EnergyThreshold);
-   if (fHNevtE[type]) {
-      if (name.CompareTo(fHNevtE[type]->GetName())==0 && (!refresh))
-         return fHNevtE[type];
-      else delete fHNevtE[type];
-   }
+//______________________________________________________________________________
+//
 
-   // define bins
-   Int_t nbinse=0;
-   Double_t e=0, de, ebins[200];
-   while (e<50.) {
-      if (e<4.9999) de=0.1;
-      else if (e<9.9999) de=0.25;
-      else if (e<20.) de=0.5;
-      else de=1;
-      ebins[nbinse]=e;
-      nbinse++;
-      e+=de;
-   }
-   ebins[nbinse]=e;
+Double_t SupernovaExperiment::EvaluateUnit(UShort_t type, const Double_t *time,
+      Double_t Enr, Long64_t *neval) const
+{
+   CNNS_STATS(ThreadStats().Integrals++);
+   Double_t minEv = DetectableEv(Enr)/MeV, maxEv = EMax();
+   if (minEv<EMin()) minEv=EMin();
+   Double_t t = time ? *time/sec : 0;
 
-   // create histogram
-   Double_t minEr = fDetector->EnergyThreshold;
-   //Info("HNevtE","Create HNevtE-%d with threshold %.3f keVnr",type,minEr/keV);
-   fHNevtE[type] = new TH1D(name.Data(),"",nbinse,ebins);
-
-   // fill histogram
-   for (Int_t ix=1; ix<=fHNevtE[type]->GetNbinsX(); ix++) {
-      Double_t e = fHNevtE[type]->GetXaxis()->GetBinCenter(ix);
-      if (e*keV<minEr) continue; // skip events below threshold
-      Double_t nevt = NevtE(type,e*keV);
-      fHNevtE[type]->SetBinContent(ix, nevt);
-   }
-   fHNevtE[type]->SetStats(0);
-   fHNevtE[type]->SetTitle(Form("%s",fModel->GetTitle()));
-   fHNevtE[type]->SetXTitle("true nuclear recoil energy [keV]");
-   fHNevtE[type]->SetYTitle(Form(
-            "number of events / (keV#times %.0f kg)",
-            fDetector->TargetMass/kg));
-   fHNevtE[type]->GetYaxis()->SetTitleOffset(1.3);
-   if (type==0) fHNevtE[type]->SetLineColor(kGray+2);
-   else fHNevtE[type]->SetLineColor(type);
+   // integrand of this call only, as the workers of Integrate have theirs
+   TF1 f("fXSxFlux", [this, type, Enr, time, t](Double_t *x, Double_t *) {
+         gNeval++;
+         Double_t dXS = TargetdXS(Enr, x[0]*MeV);
+         if (time) return dXS * N2(type,t,x[0])/sec/MeV;
+         return dXS * Ne(type,x[0])/MeV;
+         }, minEv, maxEv, 0, 1, TF1::EAddToList::kNo);
+   Double_t norm = Normalization()*keV*(time ? sec : 1);
+   return norm*Quadrature(&f, minEv, maxEv, 0, neval);
+}
 
-   return fHNevtE[type];
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::GaussLegendreNodes()
+{
+   LegendreNodes(fGLx, fGLw);
+}
+
+//______________________________________________________________________________
+//
+
+Int_t SupernovaExperiment::LegendreOrder(Int_t k) const
+{
+   Int_t n = k==0 ? GaussLegendreOrder : GaussLegendreOrder/2;
+   Int_t min = k==0 ? 2 : 1;
+   return n<min ? min : n;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::LegendreNodes(std::vector<Double_t> *x,
+      std::vector<Double_t> *w) const
+{
+   for (Int_t k=0; k<2; k++) {
+      Int_t n = LegendreOrder(k);
+      if (Int_t(x[k].size())==n) continue;
+      x[k].resize(n);
+      w[k].resize(n);
+      // roots of the Legendre polynomial by Newton's method
+      for (Int_t i=0; i<(n+1)/2; i++) {
+         Double_t z = Cos(Pi()*(i+0.75)/(n+0.5)), z1, pp;
+         do {
+            Double_t p1=1, p2=0;
+            for (Int_t j=1; j<=n; j++) {
+               Double_t p3=p2;
+               p2=p1;
+               p1=((2*j-1)*z*p2-(j-1)*p3)/j;
+            }
+            pp = n*(z*p1-p2)/(z*z-1);
+            z1 = z;
+            z = z1-p1/pp;
+         } while (Abs(z-z1)>3e-16);
+         x[k][i] = -z;
+         x[k][n-1-i] = z;
+         w[k][i] = w[k][n-1-i] = 2/((1-z*z)*pp*pp);
+      }
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::Quadrature(TF1 *f, Double_t a, Double_t b,
+      Double_t *error, Long64_t *neval) const
+{
+   Long64_t start = gNeval;
+   Double_t integral=0, err=0;
+   if (b<=a) {
+      if (error) *error=0;
+      return 0;
+   }
+
+   if (Integration==kGaussLegendre) {
+      // nodes shared by GaussLegendreNodes, else of this call only
+      const std::vector<Double_t> *gx=fGLx, *gw=fGLw;
+      std::vector<Double_t> x[2], w[2];
+      if (Int_t(fGLx[0].size())!=LegendreOrder(0)
+            || Int_t(fGLx[1].size())!=LegendreOrder(1)) {
+         LegendreNodes(x, w);
+         gx=x;
+         gw=w;
+      }
+      Double_t sum[2] = {0, 0}, c=(a+b)/2, h=(b-a)/2;
+      for (Int_t k=0; k<2; k++)
+         for (size_t i=0; i<gx[k].size(); i++)
+            sum[k] += gw[k][i]*f->Eval(c+h*gx[k][i]);
+      integral = h*sum[0];
+      err = h*Abs(sum[0]-sum[1]);
+   } else if (Integration==kGaussKronrod) {
+      // 7-point Gauss embedded in 15-point Kronrod, QUADPACK abscissae
+      static const Double_t xgk[8] = {0.991455371120812639, 0.949107912342758525,
+         0.864864423359769073, 0.741531185599394440, 0.586087235467691130,
+         0.405845151377397167, 0.207784955007898468, 0.};
+      static const Double_t wgk[8] = {0.022935322010529225, 0.063092092629978553,
+         0.104790010322250184, 0.140653259715525919, 0.169004726639267903,
+         0.190350578064785410, 0.204432940075298892, 0.209482141084727828};
+      static const Double_t wg[4] = {0.129484966168869693, 0.279705391489276668,
+         0.381830050505118945, 0.417959183673469388};
+      struct Interval { Double_t a, b, integral, error; };
+      auto kronrod = [&](Double_t lo, Double_t hi) {
+         Double_t c=(lo+hi)/2, h=(hi-lo)/2, fc=f->Eval(c);
+         Double_t k=wgk[7]*fc, g=wg[3]*fc;
+         for (Int_t j=0; j<7; j++) {
+            Double_t sum = f->Eval(c-h*xgk[j])+f->Eval(c+h*xgk[j]);
+            k += wgk[j]*sum;
+            if (j%2==1) g += wg[j/2]*sum;
+         }
+         Interval in = {lo, hi, h*k, h*Abs(k-g)};
+         return in;
+      };
+      // split the interval with the largest error until within Tolerance
+      std::vector<Interval> intervals(1, kronrod(a, b));
+      integral = intervals[0].integral;
+      err = intervals[0].error;
+      while (err>Tolerance*Abs(integral) && intervals.size()<200) {
+         size_t worst=0;
+         for (size_t i=1; i<intervals.size(); i++)
+            if (intervals[i].error>intervals[worst].error) worst=i;
+         Interval in = intervals[worst];
+         Double_t m = (in.a+in.b)/2;
+         intervals[worst] = kronrod(in.a, m);
+         intervals.push_back(kronrod(m, in.b));
+         integral += intervals[worst].integral+intervals.back().integral
+            -in.integral;
+         err += intervals[worst].error+intervals.back().error-in.error;
+      }
+   } else
+      integral = f->IntegralOneDim(a, b, 1e-12, 1e-12, err);
+
+   if (error) *error = err;
+   if (neval) *neval += gNeval-start;
+   return integral;
+}
+
+//______________________________________________________________________________
+//
+
+XSTable* SupernovaExperiment::CrossSectionTable()
+{
+   Material *material = fDetector->TargetMaterial;
+   Int_t nelements = material->Nelements();
+   // elements of fXSTable may belong to a detector deleted since it was
+   // built, so they are compared by ElementKey and replaced if identical
+   Bool_t same = fXSTable && Int_t(fXSElements.size())==nelements
+      && fXSTable->MaxEv()>=EMax()*MeV;
+   for (Int_t i=0; same && i<nelements; i++)
+      same = fXSElements[i]==ElementKey(material->GetElement(i))
+         && fXSTable->Weight(i)==Abundance(i);
+   if (same) {
+      for (Int_t i=0; i<nelements; i++)
+         fXSTable->SetElement(i, material->GetElement(i));
+      return fXSTable;
+   }
+   if (fXSTable) delete fXSTable;
+   if (fResponse) {
+      delete fResponse;
+      fResponse=0;
+   }
+
+   // tables of all elements on a common grid wide enough for the model
+   Double_t maxEv = EMax()*MeV;
+   for (Int_t i=0; i<nelements; i++) {
+      std::map<TString, XSTable*>::iterator it =
+         fKernels.find(ElementKey(material->GetElement(i)));
+      if (it!=fKernels.end() && it->second->MaxEv()>maxEv)
+         maxEv = it->second->MaxEv();
+   }
+   Double_t ebins[200], Er[200];
+   Int_t nbinse = RecoilBins(ebins);
+   for (Int_t i=0; i<nbinse; i++) Er[i] = (ebins[i]+ebins[i+1])/2*keV;
+   fXSTable = new XSTable;
+   fXSElements.clear();
+   for (Int_t i=0; i<nelements; i++) {
+      Element *element = material->GetElement(i);
+      fXSElements.push_back(ElementKey(element));
+      XSTable *&kernel = fKernels[fXSElements.back()];
+      if (kernel && kernel->MaxEv()!=maxEv) {
+         delete kernel;
+         kernel=0;
+      }
+      if (!kernel) kernel = new XSTable(element, nbinse, Er, maxEv);
+      else kernel->SetElement(0, element); // the old one may be deleted
+      fXSTable->Add(kernel, Abundance(i));
+   }
+
+   // keep kernels of a few other targets, e.g. to switch back and forth
+   const size_t maxKernels=16;
+   if (fKernels.size()>maxKernels) {
+      std::map<TString, XSTable*>::iterator it=fKernels.begin();
+      while (it!=fKernels.end()) {
+         if (std::find(fXSElements.begin(), fXSElements.end(), it->first)
+               ==fXSElements.end()) {
+            delete it->second;
+            fKernels.erase(it++);
+         } else it++;
+      }
+   }
+
+   // fluxes were tabulated on the grid of the old table
+   for (UShort_t i=0; i<SupernovaModel::fgNtype; i++) {
+      fFluxNe[i].clear();
+      fFluxN2[i].clear();
+   }
+   return fXSTable;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::TabulateFlux(UShort_t type, const Double_t *time,
+      Int_t n, const Double_t *Ev, Double_t *flux)
+{
+   Double_t t = time ? *time/sec : 0;
+   Double_t unit = time ? sec*MeV : MeV;
+   for (Int_t i=0; i<n; i++) {
+      Double_t e = Ev[i]/MeV;
+      if (e<EMin() || e>EMax()) flux[i]=0;
+      else if (time) flux[i] = N2(type,t,e)/unit;
+      else flux[i] = Ne(type,e)/unit;
+   }
+}
+
+//______________________________________________________________________________
+//
+
+const Double_t* SupernovaExperiment::FluxNe(UShort_t type)
+{
+   XSTable *table = CrossSectionTable();
+   if (!fFluxNe[type].empty()) return fFluxNe[type].data();
+
+   fFluxNe[type].resize(table->NEv());
+   TabulateFlux(type, 0, table->NEv(), table->Ev(), fFluxNe[type].data());
+   return fFluxNe[type].data();
+}
+
+//______________________________________________________________________________
+//
+
+const Double_t* SupernovaExperiment::FluxN2(UShort_t type, Double_t time)
+{
+   XSTable *table = CrossSectionTable();
+   if (!fFluxN2[type].empty() && fFluxTime[type]==time)
+      return fFluxN2[type].data();
+
+   fFluxTime[type]=time;
+   fFluxN2[type].resize(table->NEv());
+   TabulateFlux(type, &time, table->NEv(), table->Ev(), fFluxN2[type].data());
+   return fFluxN2[type].data();
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::TabulateNe(UShort_t type, Double_t Enr,
+      Double_t *error, Long64_t *neval)
+{
+   XSTable *table = CrossSectionTable();
+   const Double_t *flux = FluxNe(type);
+
+   std::vector<Double_t> buffer;
+   const Double_t *row;
+   Int_t i = table->FindEr(Enr);
+   if (i>=0) row = table->Row(i);
+   else {
+      buffer.resize(table->NEv());
+      table->FillRow(Enr, buffer.data());
+      row = buffer.data();
+   }
+
+   Double_t minEv = EMin()*MeV;
+   Double_t maxEv = EMax()*MeV;
+   Double_t norm = Normalization()/MeV*keV;
+   Double_t integral = table->Integral(row,flux,minEv,maxEv);
+   // Richardson estimate from every second grid point
+   if (error) *error += norm*Abs(integral
+         -table->Integral(row,flux,minEv,maxEv,2))/3;
+   if (neval) *neval += table->Npoints(minEv,maxEv);
+   return norm*integral;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::TabulateN2(UShort_t type, Double_t time,
+      Double_t Enr, Double_t *error, Long64_t *neval)
+{
+   XSTable *table = CrossSectionTable();
+   const Double_t *flux = FluxN2(type, time);
+
+   std::vector<Double_t> buffer;
+   const Double_t *row;
+   Int_t i = table->FindEr(Enr);
+   if (i>=0) row = table->Row(i);
+   else {
+      buffer.resize(table->NEv());
+      table->FillRow(Enr, buffer.data());
+      row = buffer.data();
+   }
+
+   Double_t minEv = EMin()*MeV;
+   Double_t maxEv = EMax()*MeV;
+   Double_t norm = Normalization()/MeV*keV*sec;
+   Double_t integral = table->Integral(row,flux,minEv,maxEv);
+   if (error) *error += norm*Abs(integral
+         -table->Integral(row,flux,minEv,maxEv,2))/3;
+   if (neval) *neval += table->Npoints(minEv,maxEv);
+   return norm*integral;
+}
+
+//______________________________________________________________________________
+//
+
+ResponseMatrix* SupernovaExperiment::Response()
+{
+   XSTable *table = CrossSectionTable();
+   if (fResponse) return fResponse;
+
+   Double_t ebins[200];
+   RecoilBins(ebins);
+   fResponse = new ResponseMatrix(table, ebins, keV/MeV);
+   return fResponse;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::ResponseNe(UShort_t type, Double_t Enr)
+{
+   Int_t i = CrossSectionTable()->FindEr(Enr);
+   if (i<0) return TabulateNe(type, Enr); // not on the default bins
+   return Normalization()*Response()->Apply(i, FluxNe(type));
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::ResponseN2(UShort_t type, Double_t time,
+      Double_t Enr)
+{
+   Int_t i = CrossSectionTable()->FindEr(Enr);
+   if (i<0) return TabulateN2(type, time, Enr); // not on the default bins
+   return Normalization()*Response()->Apply(i, FluxN2(type,time))*sec;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::XSCoefficients(Element *element, Double_t Enr,
+      Double_t minEv, Double_t maxEv, Double_t *a)
+{
+   Double_t u[3], y[3];
+   for (Int_t i=0; i<3; i++) {
+      Double_t Ev = minEv + (maxEv-minEv)*(i+1)/3;
+      u[i] = 1/Ev;
+      y[i] = element->CNNSdXS(Enr, Ev);
+   }
+   // Newton's divided differences in u=1/Ev
+   Double_t d1 = (y[1]-y[0])/(u[1]-u[0]);
+   Double_t d2 = (y[2]-y[1])/(u[2]-u[1]);
+   a[2] = (d2-d1)/(u[2]-u[0]);
+   a[1] = d1 - a[2]*(u[0]+u[1]);
+   a[0] = y[0] - a[1]*u[0] - a[2]*u[0]*u[0];
+}
+
+//______________________________________________________________________________
+//
+
+FluxMoments* SupernovaExperiment::MomentsNe(UShort_t type)
+{
+   if (!fMomentsNe[type].IsEmpty()) return &fMomentsNe[type];
+
+   const Int_t n=1001;
+   Double_t Ev[n], flux[n];
+   for (Int_t i=0; i<n; i++) Ev[i] = EMax()*MeV*i/(n-1);
+   TabulateFlux(type, 0, n, Ev, flux);
+   fMomentsNe[type] = FluxMoments(n, Ev[0], Ev[n-1], flux);
+   return &fMomentsNe[type];
+}
+
+//______________________________________________________________________________
+//
+
+FluxMoments* SupernovaExperiment::MomentsN2(UShort_t type, Double_t time)
+{
+   std::map<Double_t, FluxMoments>::iterator it = fMomentsN2[type].find(time);
+   if (it!=fMomentsN2[type].end()) return &it->second;
+
+   const Int_t n=1001;
+   Double_t Ev[n], flux[n];
+   for (Int_t i=0; i<n; i++) Ev[i] = EMax()*MeV*i/(n-1);
+   TabulateFlux(type, &time, n, Ev, flux);
+   fMomentsN2[type][time] = FluxMoments(n, Ev[0], Ev[n-1], flux);
+   return &fMomentsN2[type][time];
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::MomentIntegral(const FluxMoments *moments,
+      Double_t Enr)
+{
+   Material *material = fDetector->TargetMaterial;
+   Bool_t kept = fAbundance.size()==material->Nelements();
+   Double_t maxEv = EMax()*MeV, sum=0;
+   for (UShort_t i=0; i<material->Nelements(); i++) {
+      Element *element = material->GetElement(i);
+      Double_t minEv = (Enr + Sqrt(2*element->M()*Enr))/2;
+      if (minEv<EMin()*MeV) minEv = EMin()*MeV;
+      if (minEv>=maxEv) continue;
+
+      Double_t a[FluxMoments::fgNmoments];
+      XSCoefficients(element, Enr, minEv, maxEv, a);
+      Double_t abundance = material->Nelements()==1 ? 1
+         : (kept ? fAbundance[i] : Abundance(i));
+      sum += abundance*moments->Integral(a, minEv);
+   }
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::MomentNe(UShort_t type, Double_t Enr)
+{
+   return Normalization()*MomentIntegral(MomentsNe(type), Enr)/MeV*keV;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::MomentN2(UShort_t type, Double_t time,
+      Double_t Enr)
+{
+   return Normalization()*MomentIntegral(MomentsN2(type,time), Enr)
+      /MeV*keV*sec;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::ValidateMoments(UShort_t type,
+      Double_t tolerance)
+{
+   if (!CanCalculate("ValidateMoments")) return 0;
+
+   EIntegration integration = Integration;
+   Double_t ebins[200];
+   Int_t nbinse = RecoilBins(ebins);
+   Double_t maxDiff=0;
+   for (Int_t i=0; i<nbinse; i++) {
+      Double_t Enr = (ebins[i]+ebins[i+1])/2*keV;
+      if (Enr<fDetector->EnergyThreshold) continue;
+      Integration = kMoments;
+      Double_t moment = NevtE(type, Enr);
+      Integration = kAdaptive;
+      Double_t adaptive = NevtE(type, Enr);
+      if (adaptive==0) continue;
+      Double_t diff = Abs(moment/adaptive-1);
+      if (diff>tolerance) Info("ValidateMoments",
+            "Enr=%.2f keV: moments %g, adaptive %g, difference %.1e",
+            Enr/keV, moment, adaptive, diff);
+      if (diff>maxDiff) maxDiff=diff;
+   }
+   Integration = integration;
+   return maxDiff;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Integrate(UShort_t type, Int_t n,
+      const Double_t *time, const Double_t *Enr, Double_t *nevt,
+      Double_t *error, Long64_t *neval)
+{
+   for (Int_t i=0; i<n; i++) {
+      nevt[i]=0;
+      if (error) error[i]=0;
+      if (neval) neval[i]=0;
+   }
+   if (!CanCalculate(time?"Nevt2":"NevtE")) return;
+
+   UInt_t nthreads = Nthreads;
+   if (nthreads>static_cast<UInt_t>(n)) nthreads=n;
+   // tabulated integrals are cheap and share cached fluxes, no threading
+   if (nthreads<=1 || Integration==kTabulated || Integration==kMoments
+         || Integration==kResponse) {
+      for (Int_t i=0; i<n; i++) nevt[i] = time ?
+         UnitNevt2(type,time[i],Enr[i],error?error+i:0,neval?neval+i:0) :
+         UnitNevtE(type,Enr[i],error?error+i:0,neval?neval+i:0);
+      return;
+   }
+   if (Integration==kGaussLegendre) GaussLegendreNodes(); // shared, read only
+
+   // TF1 objects are created in the main thread and are not registered in
+   // the global list of functions, each worker only changes its own one
+   ROOT::EnableThreadSafety();
+   std::vector<TF1*> f(nthreads);
+   for (UInt_t w=0; w<nthreads; w++) {
+      if (time) {
+         f[w] = new TF1(Form("fFXSxN2%d-%d",type,w), this,
+               &SupernovaExperiment::XSxN2, 0., EMax(), 3, 1,
+               TF1::EAddToList::kNo);
+         f[w]->SetParameter(1,type);
+      } else {
+         f[w] = new TF1(Form("fFXSxNe%d-%d",type,w), this,
+               &SupernovaExperiment::XSxNe, 0., EMax(), 2, 1,
+               TF1::EAddToList::kNo);
+         f[w]->SetParameter(1,type);
+      }
+   }
+
+   // bins are interleaved among workers to balance the load
+   std::vector<std::thread> workers;
+   for (UInt_t w=0; w<nthreads; w++) {
+      workers.push_back(std::thread([&, w]() {
+         for (Int_t i=w; i<n; i+=nthreads) {
+            CNNS_STATS(ThreadStats().Integrals++);
+            nevt[i] = time ? IntegrateN2(f[w],time[i],Enr[i],
+                  error?error+i:0,neval?neval+i:0)
+               : IntegrateNe(f[w],Enr[i],error?error+i:0,neval?neval+i:0);
+         }
+      }));
+   }
+   for (UInt_t w=0; w<nthreads; w++) {
+      workers[w].join();
+      delete f[w];
+   }
+}
+
+//______________________________________________________________________________
+//
+
+TF1* SupernovaExperiment::FXSxNe(UShort_t type, Double_t Enr)
+{
+   if (fFXSxNe[type]) {
+      fFXSxNe[type]->SetParameter(0,Enr);
+      return fFXSxNe[type];
+   }
+
+   fFXSxNe[type] = new TF1(Form("fFXSxNe%s%s%f%d", Source()->GetName(),
+            fDetector->TargetMaterial->GetName(), fDetector->TargetMass,
+            type), this, &SupernovaExperiment::XSxNe, 0., EMax(),2);
+   fFXSxNe[type]->SetParameter(0,Enr);
+   fFXSxNe[type]->SetParameter(1,type);
+
+   if (type==0) {
+      fFXSxNe[type]->SetTitle(Form(
+               "%s, target: %s, recoil energy: %.1f keV;neutrino energy [MeV];1/MeV^{4}", 
+               Source()->GetName(), fDetector->TargetMaterial->GetTitle(), Enr));
+      fFXSxNe[type]->SetLineColor(kGray+2);
+      fFXSxNe[type]->SetLineWidth(2);
+   } else {
+      fFXSxNe[type]->SetTitle(Form(
+               "neutrino %d from %s, target: %s;neutrino energy [MeV];1/MeV^{4}", 
+               type,Source()->GetName(),fDetector->TargetMaterial->GetTitle()));
+      fFXSxNe[type]->SetLineColor(type);
+   }
+   return fFXSxNe[type];
+}
+
+//______________________________________________________________________________
+//
+
+TF1* SupernovaExperiment::FXSxN2(UShort_t type, Double_t time, Double_t Enr)
+{
+   if (fFXSxN2[type]) {
+      fFXSxN2[type]->SetParameter(0,Enr);
+      fFXSxN2[type]->SetParameter(2,time);
+      return fFXSxN2[type];
+   }
+
+   fFXSxN2[type] = new TF1(Form("fFXSxN2%s%s%f%d", Source()->GetName(),
+            fDetector->TargetMaterial->GetName(), fDetector->TargetMass,
+            type), this, &SupernovaExperiment::XSxN2, 0., EMax(),3);
+   fFXSxN2[type]->SetParameter(0,Enr);
+   fFXSxN2[type]->SetParameter(1,type);
+   fFXSxN2[type]->SetParameter(2,time);
+
+   if (type==0) {
+      fFXSxN2[type]->SetTitle(Form(
+               "%s, target: %s, recoil energy: %.1f keV, time: %.1f second;neutrino energy [MeV];1/MeV^{4}", 
+               Source()->GetName(), 
+               fDetector->TargetMaterial->GetTitle(), Enr, time));
+      fFXSxN2[type]->SetLineColor(kGray+2);
+      fFXSxN2[type]->SetLineWidth(2);
+   } else {
+      fFXSxN2[type]->SetTitle(Form(
+               "neutrino %d from %s, target: %s, recoil energy : %.1f, time: %.1f second;neutrino energy [MeV];1/MeV^{4}", 
+               type, Source()->GetName(), 
+               fDetector->TargetMaterial->GetTitle(), Enr, time));
+      fFXSxN2[type]->SetLineColor(type);
+   }
+   return fFXSxN2[type];
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::Nevt()
+{
+   return Nevt(0, fDetector->EnergyThreshold);
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::Nevt(UShort_t type, Double_t minEr)
+{
+   if (type>6) {
+      Warning("Nevt","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      return 0;
+   }
+   if (!CanCalculate("Nevt")) return 0;
+
+   // bins with lower edges above threshold, found by binary search
+   TH1D* h = UnitHNevtE(type);
+   const Double_t *edges = h->GetXaxis()->GetXbins()->GetArray();
+   Int_t n = h->GetNbinsX(), low=0, high=n;
+   while (low<high) {
+      Int_t mid = (low+high)/2;
+      if (edges[mid]*keV<minEr) low=mid+1;
+      else high=mid;
+   }
+   return Scale()*(fCumE[type][n]-fCumE[type][low]);
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* SupernovaExperiment::HXSxNe(UShort_t type, Double_t Enr)
+{
+   if (type>6) {
+      Warning("HXSxNe","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HXSxNe","Return NULL pointer!");
+      return 0;
+   }
+   TH1D *h = (TH1D*) FXSxNe(type, Enr/keV)->GetHistogram();
+   return h;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Clear(Option_t *option)
+{
+   for (UShort_t i=0; i<SupernovaModel::fgNtype; i++) ClearType(i);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::ClearType(UShort_t i)
+{
+   ClearViews(i);
+   if (fHUnit2[i]) {
+      delete fHUnit2[i];
+      fHUnit2[i]=NULL;
+   }
+   if (fHUnitE[i]) {
+      delete fHUnitE[i];
+      fHUnitE[i]=NULL;
+   }
+   fFluxNe[i].clear();
+   fFluxN2[i].clear();
+   fMomentsNe[i] = FluxMoments();
+   fMomentsN2[i].clear();
+   fCumE[i].clear();
+   fCum2[i].clear();
+   fErr2[i].clear();
+   fLazy2[i].clear();
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::ClearViews(UShort_t i)
+{
+   if (fFXSxNe[i]) {
+      delete fFXSxNe[i];
+      fFXSxNe[i]=NULL;
+   }
+   if (fFXSxN2[i]) {
+      delete fFXSxN2[i];
+      fFXSxN2[i]=NULL;
+   }
+   if (fHNevt2[i]) {
+      delete fHNevt2[i];
+      fHNevt2[i]=NULL;
+   }
+   if (fHNevtT[i]) {
+      delete fHNevtT[i];
+      fHNevtT[i]=NULL;
+   }
+   if (fHNevtE[i]) {
+      delete fHNevtE[i];
+      fHNevtE[i]=NULL;
+   }
+   fSnapshot[i].reset(); // still valid for those who share it
+   fCumEff2[i].clear();
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Fill(UShort_t type, TH2D *h)
+{
+   Int_t nbinst = h->GetNbinsX(), nbinse = h->GetNbinsY();
+   if (Integration==kResponse) {
+      if (!CanCalculate("HNevt2")) return;
+      // all bins at once: K(Enr, Ev) x N2(Ev, t)
+      Double_t start = StatsClock();
+      Int_t nEv = Response()->NEv();
+      std::vector<Double_t> flux(nEv*nbinst), column(nEv), nevt(nbinse*nbinst);
+      for (Int_t ix=1; ix<=nbinst; ix++) {
+         Double_t t = h->GetXaxis()->GetBinCenter(ix)*sec;
+         TabulateFlux(type, &t, nEv, CrossSectionTable()->Ev(), column.data());
+         for (Int_t j=0; j<nEv; j++) flux[j*nbinst+ix-1] = column[j];
+      }
+      Response()->Apply(nbinst, flux.data(), nevt.data());
+      Double_t norm = Normalization()*sec;
+      for (Int_t iy=1; iy<=nbinse; iy++)
+         for (Int_t ix=1; ix<=nbinst; ix++)
+            h->SetBinContent(ix, iy, nevt[(iy-1)*nbinst+ix-1]*norm);
+      Record(h, Long64_t(nEv)*nbinst, // flux evaluations
+            nbinse*nbinst, StatsClock()-start);
+      return;
+   }
+
+   std::vector<Int_t> bin;
+   std::vector<Double_t> time, Enr;
+   for (Int_t ix=1; ix<=nbinst; ix++) {
+      for (Int_t iy=1; iy<=nbinse; iy++) {
+         Double_t t = h->GetXaxis()->GetBinCenter(ix);
+         Double_t e = h->GetYaxis()->GetBinCenter(iy);
+         bin.push_back(h->GetBin(ix,iy));
+         time.push_back(t*sec);
+         Enr.push_back(e*keV);
+      }
+   }
+   std::vector<Double_t> nevt(bin.size()), error(bin.size());
+   std::vector<Long64_t> neval(bin.size());
+   Double_t start = StatsClock();
+   Integrate(type, bin.size(), time.data(), Enr.data(), nevt.data(),
+         error.data(), neval.data());
+   Double_t filltime = StatsClock()-start;
+   CNNS_STATS(Stats &stats = ThreadStats());
+   CNNS_STATS(stats.Fills++);
+   CNNS_STATS(stats.FillIntegrals += bin.size());
+   CNNS_STATS(stats.FillTime += filltime);
+   Long64_t total=0;
+   for (size_t i=0; i<bin.size(); i++) {
+      h->SetBinContent(bin[i], nevt[i]);
+      h->SetBinError(bin[i], error[i]);
+      total += neval[i];
+   }
+   Record(h, total, bin.size(), filltime);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Fill(UShort_t type, TH1D *h)
+{
+   Int_t nbinse = h->GetNbinsX();
+   if (Integration==kResponse) {
+      if (!CanCalculate("HNevtE")) return;
+      // all bins at once: K(Enr, Ev) x Ne(Ev)
+      Double_t start = StatsClock();
+      std::vector<Double_t> nevt(nbinse);
+      Response()->Apply(FluxNe(type), nevt.data());
+      Double_t norm = Normalization();
+      for (Int_t ix=1; ix<=nbinse; ix++) h->SetBinContent(ix, nevt[ix-1]*norm);
+      Record(h, Response()->NEv(), // flux evaluations
+            nbinse, StatsClock()-start);
+      return;
+   }
+
+   std::vector<Int_t> bin;
+   std::vector<Double_t> Enr;
+   for (Int_t ix=1; ix<=nbinse; ix++) {
+      Double_t e = h->GetXaxis()->GetBinCenter(ix);
+      bin.push_back(ix);
+      Enr.push_back(e*keV);
+   }
+   std::vector<Double_t> nevt(bin.size()), error(bin.size());
+   std::vector<Long64_t> neval(bin.size());
+   Double_t start = StatsClock();
+   Integrate(type, bin.size(), 0, Enr.data(), nevt.data(), error.data(),
+         neval.data());
+   Double_t filltime = StatsClock()-start;
+   CNNS_STATS(Stats &stats = ThreadStats());
+   CNNS_STATS(stats.Fills++);
+   CNNS_STATS(stats.FillIntegrals += bin.size());
+   CNNS_STATS(stats.FillTime += filltime);
+   Long64_t total=0;
+   for (size_t i=0; i<bin.size(); i++) {
+      h->SetBinContent(bin[i], nevt[i]);
+      h->SetBinError(bin[i], error[i]);
+      total += neval[i];
+   }
+   Record(h, total, bin.size(), filltime);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Combine(TH2D *h)
+{
+   // integration errors of flavors are added linearly
+   Long64_t neval=0, nintegrals=0;
+   Double_t filltime=0;
+   for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+      if (fFlavorWeight[i]==0) continue;
+      TH2D *flavor = UnitHNevt2(i);
+      for (Int_t bin=0; bin<h->GetNcells(); bin++) {
+         h->SetBinContent(bin, h->GetBinContent(bin)
+               + fFlavorWeight[i]*flavor->GetBinContent(bin));
+         h->SetBinError(bin, h->GetBinError(bin)
+               + Abs(fFlavorWeight[i])*flavor->GetBinError(bin));
+      }
+      neval += Nevaluations(flavor);
+      nintegrals += Nintegrals(flavor);
+      filltime += FillTime(flavor);
+   }
+   Record(h, neval, nintegrals, filltime);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Combine(TH1D *h, Bool_t refresh)
+{
+   Long64_t neval=0, nintegrals=0;
+   Double_t filltime=0;
+   for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+      if (fFlavorWeight[i]==0) continue;
+      TH1D *flavor = UnitHNevtE(i, refresh);
+      for (Int_t bin=0; bin<h->GetNcells(); bin++) {
+         h->SetBinContent(bin, h->GetBinContent(bin)
+               + fFlavorWeight[i]*flavor->GetBinContent(bin));
+         h->SetBinError(bin, h->GetBinError(bin)
+               + Abs(fFlavorWeight[i])*flavor->GetBinError(bin));
+      }
+      neval += Nevaluations(flavor);
+      nintegrals += Nintegrals(flavor);
+      filltime += FillTime(flavor);
+   }
+   Record(h, neval, nintegrals, filltime);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Rescale(TH2D *h, const TH2D *unit, Double_t scale,
+      Double_t minEr)
+{
+   for (Int_t iy=1; iy<=h->GetNbinsY(); iy++) {
+      Double_t e = h->GetYaxis()->GetBinCenter(iy);
+      for (Int_t ix=1; ix<=h->GetNbinsX(); ix++) {
+         if (e*keV<minEr) { // below threshold
+            h->SetBinContent(ix, iy, 0);
+            h->SetBinError(ix, iy, 0);
+         } else {
+            h->SetBinContent(ix, iy, unit->GetBinContent(ix,iy)*scale);
+            h->SetBinError(ix, iy, unit->GetBinError(ix,iy)*scale);
+         }
+      }
+   }
+   Record(h, unit);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Rescale(TH1D *h, const TH1D *unit, Double_t scale,
+      Double_t minEr)
+{
+   for (Int_t ix=1; ix<=h->GetNbinsX(); ix++) {
+      Double_t e = h->GetXaxis()->GetBinCenter(ix);
+      if (e*keV<minEr) { // below threshold
+         h->SetBinContent(ix, 0);
+         h->SetBinError(ix, 0);
+      } else {
+         h->SetBinContent(ix, unit->GetBinContent(ix)*scale);
+         h->SetBinError(ix, unit->GetBinError(ix)*scale);
+      }
+   }
+   Record(h, unit);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Record(TH1 *h, Long64_t neval, Long64_t nintegrals,
+      Double_t filltime)
+{
+   FillRecord record = {neval, nintegrals, filltime};
+   fRecords[h->GetName()] = record;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Record(TH1 *h, const char *from)
+{
+   std::map<TString, FillRecord>::const_iterator it = fRecords.find(from);
+   if (it==fRecords.end()) Record(h, Long64_t(0));
+   else fRecords[h->GetName()] = it->second;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Record(TH1 *h, const TH1 *from)
+{
+   Record(h, from->GetName());
+}
+
+//______________________________________________________________________________
+//
+
+SupernovaExperiment::FillRecord SupernovaExperiment::RecordOf(
+      const TH1 *h) const
+{
+   std::map<TString, FillRecord>::const_iterator it =
+      fRecords.find(h->GetName());
+   if (it!=fRecords.end()) return it->second;
+   FillRecord none = {0, 0, 0};
+   return none;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t SupernovaExperiment::Nevaluations(const TH1 *h) const
+{
+   return RecordOf(h).Nevaluations;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t SupernovaExperiment::Nintegrals(const TH1 *h) const
+{
+   return RecordOf(h).Nintegrals;
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::FillTime(const TH1 *h) const
+{
+   return RecordOf(h).FillTime;
+}
+
+//______________________________________________________________________________
+//
+
+Long64_t SupernovaExperiment::ThreadEvaluations()
+{
+   return gNeval;
+}
+
+//______________________________________________________________________________
+//
+
+Int_t SupernovaExperiment::FirstBinAbove(TAxis *axis, Double_t minEr)
+{
+   const Double_t *edges = axis->GetXbins()->GetArray();
+   Int_t n = axis->GetNbins();
+   // bin centers increase with bin number, find the first one >= minEr
+   Int_t low=1, high=n+1;
+   while (low<high) {
+      Int_t mid = (low+high)/2;
+      if ((edges[mid-1]+edges[mid])/2*keV<minEr) low=mid+1;
+      else high=mid;
+   }
+   return low;
+}
+
+//______________________________________________________________________________
+//
+
+TString SupernovaExperiment::IntegrationSettings()
+{
+   TString settings = Form("%d|%d", Integration, fgXSVersion);
+   if (Integration==kGaussLegendre) settings += Form("|%d", GaussLegendreOrder);
+   if (Integration==kGaussKronrod) settings += Form("|%.17g", Tolerance);
+   return settings;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::CheckSettings(UShort_t type)
+{
+   TString settings = IntegrationSettings();
+   if (fUnitSettings[type]==settings) return;
+   ClearType(type);
+   fUnitSettings[type] = settings;
+}
+
+//______________________________________________________________________________
+//
+
+TString SupernovaExperiment::CacheKey(UShort_t type, TH1 *h)
+{
+   Material *material = fDetector->TargetMaterial;
+   Element *element = material->GetElement();
+   TString id = Form("%s|%d|%s|%s|%.17g|%.17g|%.17g|%s|%s|%.17g|%.17g|%s",
+         h->GetName(), type, Source()->GetName(), Source()->GetTitle(),
+         EMin(), EMax(),
+         fFlux ? fFlux->Integral() : fModel->HN2()->Integral(),
+         fDetector->TargetMaterial->GetName(), element->GetName(),
+         element->A(), element->M(), IntegrationSettings().Data());
+   if (fFlux) id += Form("|table%d|%d", FluxTable::fgVersion, fFlux->NEv());
+   for (UShort_t i=1; i<material->Nelements(); i++)
+      id += Form("|%s|%.17g|%.17g|%.17g", material->GetElement(i)->GetName(),
+            material->GetElement(i)->A(), material->GetElement(i)->M(),
+            material->Natoms(i)/material->Natoms(0));
+   for (UShort_t i=1; i<SupernovaModel::fgNtype && type==0; i++)
+      id += Form("|%.17g", fFlavorWeight[i]);
+
+   // fluxes on a grid, as models of the same name and integral can differ
+   Int_t nt;
+   const Double_t *tbins = TimeBins(nt);
+   for (Int_t it=0; it<=nt; it++) id += Form("|%.17g", tbins[it]);
+   const Int_t ngrid=8;
+   for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+      for (Int_t j=0; j<ngrid; j++) {
+         Double_t Ev = EMin()+(EMax()-EMin())*(j+0.5)/ngrid;
+         Double_t t = (tbins[j*nt/ngrid]+tbins[j*nt/ngrid+1])/2;
+         id += Form("|%.17g|%.17g",
+               fFlux ? fFlux->Ne(i,Ev) : fModel->Ne(i,Ev),
+               fFlux ? fFlux->N2(i,t,Ev) : fModel->N2(i,t,Ev));
+      }
+   }
+   TAxis *axes[2] = {h->GetXaxis(), h->GetYaxis()};
+   for (Int_t a=0; a<2; a++) {
+      const TArrayD *edges = axes[a]->GetXbins();
+      for (Int_t i=0; i<edges->GetSize(); i++)
+         id += Form("|%.17g", edges->GetArray()[i]);
+   }
+
+   TMD5 md5;
+   md5.Update(reinterpret_cast<const UChar_t*>(id.Data()), id.Length());
+   md5.Final();
+   return Form("%s_%s", h->GetName(), md5.AsString());
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::CopyResult(const TH1 *from, TH1 *to)
+{
+   for (Int_t bin=0; bin<to->GetNcells(); bin++) {
+      to->SetBinContent(bin, from->GetBinContent(bin));
+      to->SetBinError(bin, from->GetBinError(bin));
+   }
+   Record(to, from);
+}
+
+//______________________________________________________________________________
+//
+
+Bool_t SupernovaExperiment::ReadCache(const char *key, TH1 *h)
+{
+   const TH1 *kept = fResults->Get(key);
+   if (kept && kept->GetNcells()==h->GetNcells()) {
+      CNNS_STATS(ThreadStats().MemoryHits++);
+      CopyResult(kept, h); // kept is named key
+      return kTRUE;
+   }
+   CNNS_STATS(ThreadStats().MemoryMisses++);
+
+   if (CacheFile.IsNull() || gSystem->AccessPathName(CacheFile)) return kFALSE;
+
+   CacheLock lock(CacheFile, false);
+   TFile file(CacheFile, "read");
+   if (file.IsZombie()) return kFALSE;
+   TH1 *cached = dynamic_cast<TH1*>(file.Get(key));
+   if (!cached || cached->GetNcells()!=h->GetNcells()) {
+      CNNS_STATS(ThreadStats().FileMisses++);
+      return kFALSE;
+   }
+   CNNS_STATS(ThreadStats().FileHits++);
+   FillRecord record = {ReadParameter<Long64_t>(file, key, "nevaluations"),
+      ReadParameter<Long64_t>(file, key, "nintegrals"),
+      ReadParameter<Double_t>(file, key, "filltime")};
+   fRecords[key] = record;
+   CopyResult(cached, h);
+   Record(h, key);
+   fResults->Put(key, h);
+   return kTRUE;
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::WriteCache(const char *key, TH1 *h)
+{
+   fResults->Put(key, h);
+   FillRecord record = RecordOf(h);
+   fRecords[key] = record;
+   if (CacheFile.IsNull()) return;
+
+   CacheLock lock(CacheFile, true);
+   TFile file(CacheFile, "update");
+   if (file.IsZombie()) {
+      Warning("WriteCache", "Cannot open %s!", CacheFile.Data());
+      return;
+   }
+   file.WriteTObject(h, key, "WriteDelete");
+   WriteParameter(file, key, "nevaluations", record.Nevaluations);
+   WriteParameter(file, key, "nintegrals", record.Nintegrals);
+   WriteParameter(file, key, "filltime", record.FillTime);
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* SupernovaExperiment::UnitHNevt2(UShort_t type)
+{
+   CheckSettings(type);
+   if (fHUnit2[type]) {
+      CNNS_STATS(ThreadStats().UnitHits++);
+      return fHUnit2[type];
+   }
+   CNNS_STATS(ThreadStats().UnitMisses++);
+
+   // define bins
+   Int_t nbinst;
+   const Double_t *tbins = TimeBins(nbinst);
+   Double_t ebins[200];
+   Int_t nbinse = RecoilBins(ebins);
+
+   // create histogram
+   fHUnit2[type] = new TH2D(Form("hUnitNevt2-%d",type),"",
+         nbinst,tbins,nbinse,ebins);
+   fHUnit2[type]->SetDirectory(0);
+
+   // read histogram from the cache file or fill it, the sum of all flavors
+   // from cached flavors
+   TString key = CacheKey(type, fHUnit2[type]);
+   if (!ReadCache(key, fHUnit2[type])) {
+      if (type==0) Combine(fHUnit2[0]);
+      else Fill(type, fHUnit2[type]);
+      WriteCache(key, fHUnit2[type]);
+   }
+
+   // accumulate Nevt over recoil energies in each time bin
+   fCum2[type].assign(nbinst*(nbinse+1), 0);
+   fErr2[type].assign(nbinst*(nbinse+1), 0);
+   for (Int_t ix=1; ix<=nbinst; ix++) {
+      Double_t *cum = &fCum2[type][(ix-1)*(nbinse+1)];
+      Double_t *err = &fErr2[type][(ix-1)*(nbinse+1)];
+      for (Int_t iy=1; iy<=nbinse; iy++) {
+         Double_t de = fHUnit2[type]->GetYaxis()->GetBinWidth(iy);
+         cum[iy] = cum[iy-1] + fHUnit2[type]->GetBinContent(ix,iy)*de;
+         err[iy] = err[iy-1] + fHUnit2[type]->GetBinError(ix,iy)*de;
+      }
+   }
+
+   return fHUnit2[type];
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* SupernovaExperiment::HNevt2(UShort_t type)
+{
+   if (type>6) {
+      Warning("HNevt2","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevt2","Return NULL pointer!");
+      return 0;
+   }
+
+   TH2D *unit = UnitHNevt2(type);
+   TString name = Form("hNevt2-%d-%f", type, fDetector->EnergyThreshold);
+
+   // create histogram
+   if (!fHNevt2[type]) {
+      fHNevt2[type] = new TH2D(name.Data(),"",
+            unit->GetNbinsX(), unit->GetXaxis()->GetXbins()->GetArray(),
+            unit->GetNbinsY(), unit->GetYaxis()->GetXbins()->GetArray());
+      fHNevt2[type]->SetDirectory(0);
+      fHNevt2[type]->SetStats(0);
+      fHNevt2[type]->GetXaxis()->SetTitle("time [second]");
+      fHNevt2[type]->GetYaxis()->SetTitle("nuclear recoil energy [keV]");
+      fScale2[type]=0;
+   }
+
+   // scale results per unit mass at unit distance, cut at threshold
+   Double_t scale = Scale();
+   if (fScale2[type]!=scale || fThreshold2[type]!=fDetector->EnergyThreshold) {
+      CNNS_STATS(ThreadStats().ViewMisses++);
+      Rescale(fHNevt2[type], unit, scale, fDetector->EnergyThreshold);
+      fHNevt2[type]->SetName(name.Data());
+      fHNevt2[type]->SetTitle(Form("number of events / (%.0f kg)",
+               fDetector->TargetMass/kg));
+      fScale2[type]=scale;
+      fThreshold2[type]=fDetector->EnergyThreshold;
+   } else CNNS_STATS(ThreadStats().ViewHits++);
+
+   return fHNevt2[type];
+}
+
+//______________________________________________________________________________
+//
+
+const std::vector<Double_t>& SupernovaExperiment::DetectableCumulative(
+      UShort_t type)
+{
+   if (!fCumEff2[type].empty()) return fCumEff2[type];
+
+   TH2D *h = UnitHNevt2(type);
+   Int_t nbinst = h->GetNbinsX(), nbinse = h->GetNbinsY();
+   // efficiency times bin width of all recoil bins in one call
+   std::vector<Double_t> Enr(nbinse), weight(nbinse);
+   for (Int_t iy=1; iy<=nbinse; iy++)
+      Enr[iy-1] = h->GetYaxis()->GetBinCenter(iy)*keV;
+   fDetector->Efficiencies(nbinse, Enr.data(), weight.data());
+   for (Int_t iy=1; iy<=nbinse; iy++)
+      weight[iy-1] *= h->GetYaxis()->GetBinWidth(iy);
+
+   fCumEff2[type].assign(nbinst*(nbinse+1), 0);
+   for (Int_t ix=1; ix<=nbinst; ix++) {
+      Double_t *cum = &fCumEff2[type][(ix-1)*(nbinse+1)];
+      const Double_t *dn = &h->GetArray()[h->GetBin(ix,1)];
+      Int_t stride = nbinst+2; // next recoil bin in the array of a TH2D
+      for (Int_t iy=0; iy<nbinse; iy++)
+         cum[iy+1] = cum[iy] + dn[iy*stride]*weight[iy];
+   }
+   return fCumEff2[type];
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* SupernovaExperiment::HNevtT(UShort_t type, Bool_t detectableOnly)
+{
+   if (type>6) {
+      Warning("HNevtT","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevtT","Return NULL pointer!");
+      return 0;
+   }
+   TH2D *h = UnitHNevt2(type);
+
+   TString name = Form("hNevtT-%d-%f-%d", 
+         type, fDetector->EnergyThreshold, detectableOnly);
+   if (fHNevtT[type]) {
+      if (name.CompareTo(fHNevtT[type]->GetName())==0
+            && fScaleT[type]==Scale()) {
+         CNNS_STATS(ThreadStats().ViewHits++);
+         return fHNevtT[type];
+      } else delete fHNevtT[type];
+   }
+   CNNS_STATS(ThreadStats().ViewMisses++);
+   fScaleT[type]=Scale();
+
+   // create histogram
+   Int_t nbinst=h->GetXaxis()->GetNbins();
+   const Double_t *tbins = h->GetXaxis()->GetXbins()->GetArray();
+   fHNevtT[type] = new TH1D(name.Data(),"",nbinst,tbins);
+   fHNevtT[type]->SetDirectory(0);
+
+   // fill histogram from sums of Nevt over recoil energies
+   Int_t nbinse = h->GetNbinsY();
+   Int_t first = FirstBinAbove(h->GetYaxis(), fDetector->EnergyThreshold);
+   const std::vector<Double_t> &cum =
+      detectableOnly ? DetectableCumulative(type) : fCum2[type];
+   // integration errors without efficiency, an upper limit if detectable
+   for (Int_t ix=1; ix<=nbinst; ix++) {
+      const Double_t *c = &cum[(ix-1)*(nbinse+1)];
+      const Double_t *e = &fErr2[type][(ix-1)*(nbinse+1)];
+      fHNevtT[type]->SetBinContent(ix, (c[nbinse]-c[first-1])*fScaleT[type]);
+      fHNevtT[type]->SetBinError(ix, (e[nbinse]-e[first-1])*fScaleT[type]);
+   }
+   Record(fHNevtT[type], h);
+   fHNevtT[type]->SetStats(0);
+   fHNevtT[type]->SetTitle(Form("%s",Source()->GetTitle()));
+   fHNevtT[type]->SetXTitle("time [second]");
+   fHNevtT[type]->SetYTitle(Form("rate of events [Hz/(%.0f kg)]",
+            fDetector->TargetMass/kg));
+   fHNevtT[type]->GetYaxis()->SetTitleOffset(1.3);
+
+   return fHNevtT[type];
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* SupernovaExperiment::UnitHNevtE(UShort_t type, Bool_t refresh)
+{
+   CheckSettings(type);
+   if (fHUnitE[type]) {
+      if (!refresh) {
+         CNNS_STATS(ThreadStats().UnitHits++);
+         return fHUnitE[type];
+      } else delete fHUnitE[type];
+   }
+   CNNS_STATS(ThreadStats().UnitMisses++);
+
+   // define bins
+   Double_t ebins[200];
+   Int_t nbinse = RecoilBins(ebins);
+
+   // create histogram
+   fHUnitE[type] = new TH1D(Form("hUnitNevtE-%d",type),"",nbinse,ebins);
+   fHUnitE[type]->SetDirectory(0);
+
+   // read histogram from the cache file or fill it, the sum of all flavors
+   // from cached flavors
+   TString key = CacheKey(type, fHUnitE[type]);
+   if (refresh || !ReadCache(key, fHUnitE[type])) {
+      if (type==0) Combine(fHUnitE[0], refresh);
+      else Fill(type, fHUnitE[type]);
+      WriteCache(key, fHUnitE[type]);
+   }
+
+   // accumulate Nevt over recoil energies
+   fCumE[type].assign(nbinse+1, 0);
+   for (Int_t ix=1; ix<=nbinse; ix++)
+      fCumE[type][ix] = fCumE[type][ix-1]
+         + fHUnitE[type]->GetBinContent(ix)*fHUnitE[type]->GetBinWidth(ix);
+
+   return fHUnitE[type];
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* SupernovaExperiment::HNevtE(UShort_t type, Bool_t refresh)
+{
+   if (type>6) {
+      Warning("HNevtE","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevtE","Return NULL pointer!");
+      return 0;
+   }
+   if (!fDetector->TargetMaterial) {
+      Warning("HNevtE", "Please set targe material!");
+      return 0;
+   }
+
+   TH1D *unit = UnitHNevtE(type, refresh);
+   TString name = Form("hNevtE-%d-%f", type, fDetector->EnergyThreshold);
+   if (refresh) fScaleE[type]=0;
+
+   // create histogram
+   if (!fHNevtE[type]) {
+      fHNevtE[type] = new TH1D(name.Data(),"",
+            unit->GetNbinsX(), unit->GetXaxis()->GetXbins()->GetArray());
+      fHNevtE[type]->SetDirectory(0);
+      fHNevtE[type]->SetStats(0);
+      fHNevtE[type]->SetTitle(Form("%s",Source()->GetTitle()));
+      fHNevtE[type]->SetXTitle("true nuclear recoil energy [keV]");
+      fHNevtE[type]->GetYaxis()->SetTitleOffset(1.3);
+      if (type==0) fHNevtE[type]->SetLineColor(kGray+2);
+      else fHNevtE[type]->SetLineColor(type);
+      fScaleE[type]=0;
+   }
+
+   // scale results per unit mass at unit distance, cut at threshold
+   Double_t scale = Scale();
+   if (fScaleE[type]!=scale || fThresholdE[type]!=fDetector->EnergyThreshold) {
+      CNNS_STATS(ThreadStats().ViewMisses++);
+      Rescale(fHNevtE[type], unit, scale, fDetector->EnergyThreshold);
+      fHNevtE[type]->SetName(name.Data());
+      fHNevtE[type]->SetYTitle(Form(
+               "number of events / (keV#times %.0f kg)",
+               fDetector->TargetMass/kg));
+      fScaleE[type]=scale;
+      fThresholdE[type]=fDetector->EnergyThreshold;
+   } else CNNS_STATS(ThreadStats().ViewHits++);
+
+   return fHNevtE[type];
+}
+
+//______________________________________________________________________________
+//
+
+const Double_t* SupernovaExperiment::LazyUnit2(UShort_t type,
+      const std::vector<Int_t> &cells)
+{
+   CheckSettings(type);
+   Int_t nbinst, nbinse;
+   const Double_t *tbins = TimeBins(nbinst);
+   Double_t ebins[200];
+   nbinse = RecoilBins(ebins);
+   std::vector<Double_t> &lazy = fLazy2[type];
+   // cells integrated so far are kept in Results() and CacheFile as well,
+   // in a map of the unit bins that is NaN where they are not integrated
+   TH2D kept(Form("hLazyNevt2-%d",type),"",nbinst,tbins,nbinse,ebins);
+   kept.SetDirectory(0);
+   if (lazy.empty()) {
+      lazy.assign(nbinst*nbinse, std::numeric_limits<Double_t>::quiet_NaN());
+      TH2D whole(Form("hUnitNevt2-%d",type),"",nbinst,tbins,nbinse,ebins);
+      whole.SetDirectory(0);
+      if (!fHUnit2[type] && ReadCache(CacheKey(type, &whole), &whole))
+         UnitHNevt2(type); // the whole map is found, now in Results()
+      else if (type && ReadCache(CacheKey(type, &kept), &kept))
+         for (Int_t i=0; i<nbinst*nbinse; i++)
+            lazy[i] = kept.GetBinContent(i/nbinse+1, i%nbinse+1);
+   }
+
+   std::vector<Int_t> missing;
+   for (size_t i=0; i<cells.size(); i++)
+      if (std::isnan(lazy[cells[i]])) missing.push_back(cells[i]);
+   if (missing.empty()) return lazy.data();
+
+   if (fHUnit2[type]) { // the whole map is there
+      for (size_t i=0; i<missing.size(); i++)
+         lazy[missing[i]] = fHUnit2[type]->GetBinContent(
+               missing[i]/nbinse+1, missing[i]%nbinse+1);
+   } else if (type==0) { // weighted sum of flavors as in Combine
+      for (size_t i=0; i<missing.size(); i++) lazy[missing[i]]=0;
+      for (UShort_t i=1; i<SupernovaModel::fgNtype; i++) {
+         if (fFlavorWeight[i]==0) continue;
+         const Double_t *flavor = LazyUnit2(i, missing);
+         for (size_t j=0; j<missing.size(); j++)
+            lazy[missing[j]] += fFlavorWeight[i]*flavor[missing[j]];
+      }
+   } else { // integrate at bin centers as in Fill
+      std::vector<Double_t> time(missing.size()), Enr(missing.size()),
+         nevt(missing.size());
+      for (size_t i=0; i<missing.size(); i++) {
+         Int_t ix = missing[i]/nbinse, iy = missing[i]%nbinse;
+         time[i] = (tbins[ix]+tbins[ix+1])/2*sec;
+         Enr[i] = (ebins[iy]+ebins[iy+1])/2*keV;
+      }
+      Integrate(type, missing.size(), time.data(), Enr.data(), nevt.data());
+      for (size_t i=0; i<missing.size(); i++) lazy[missing[i]] = nevt[i];
+      for (Int_t i=0; i<nbinst*nbinse; i++)
+         kept.SetBinContent(i/nbinse+1, i%nbinse+1, lazy[i]);
+      WriteCache(CacheKey(type, &kept), &kept);
+   }
+   return lazy.data();
+}
+
+//______________________________________________________________________________
+//
+
+Double_t SupernovaExperiment::Nevt(UShort_t type, Double_t tmin,
+      Double_t tmax, Double_t minEr, Double_t maxEr)
+{
+   TH2D *h = HNevt2(type, tmin, tmax, minEr, maxEr);
+   if (!h) return 0;
+
+   Double_t t1=tmin/sec, t2=tmax/sec, e1=minEr/keV, e2=maxEr/keV;
+   Double_t sum=0;
+   for (Int_t ix=1; ix<=h->GetNbinsX(); ix++) {
+      Double_t lo = h->GetXaxis()->GetBinLowEdge(ix);
+      Double_t up = h->GetXaxis()->GetBinUpEdge(ix);
+      Double_t dt = (up<t2?up:t2) - (lo>t1?lo:t1);
+      for (Int_t iy=1; iy<=h->GetNbinsY(); iy++) {
+         lo = h->GetYaxis()->GetBinLowEdge(iy);
+         up = h->GetYaxis()->GetBinUpEdge(iy);
+         Double_t de = (up<e2?up:e2) - (lo>e1?lo:e1);
+         sum += h->GetBinContent(ix, iy)*dt*de;
+      }
+   }
+   delete h;
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* SupernovaExperiment::HNevt2(UShort_t type, Double_t tmin,
+      Double_t tmax, Double_t minEr, Double_t maxEr)
+{
+   if (type>6) {
+      Warning("HNevt2","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevt2","Return NULL pointer!");
+      return 0;
+   }
+   if (!CanCalculate("HNevt2")) return 0;
+
+   // bins overlapping the window
+   Int_t nbinst, nbinse;
+   const Double_t *tbins = TimeBins(nbinst);
+   Double_t ebins[200];
+   nbinse = RecoilBins(ebins);
+   Int_t t1=nbinst, t2=-1, e1=nbinse, e2=-1;
+   for (Int_t ix=0; ix<nbinst; ix++)
+      if (tbins[ix+1]*sec>tmin && tbins[ix]*sec<tmax) {
+         if (ix<t1) t1=ix;
+         t2=ix;
+      }
+   for (Int_t iy=0; iy<nbinse; iy++)
+      if (ebins[iy+1]*keV>minEr && ebins[iy]*keV<maxEr) {
+         if (iy<e1) e1=iy;
+         e2=iy;
+      }
+   if (t2<t1 || e2<e1) {
+      Warning("HNevt2", "No bin in the window, return NULL pointer!");
+      return 0;
+   }
+
+   std::vector<Int_t> cells;
+   for (Int_t ix=t1; ix<=t2; ix++)
+      for (Int_t iy=e1; iy<=e2; iy++) cells.push_back(ix*nbinse+iy);
+   const Double_t *unit = LazyUnit2(type, cells);
+
+   TH2D *h = new TH2D(Form("hNevt2-%d-window", type), Source()->GetTitle(),
+         t2-t1+1, tbins+t1, e2-e1+1, ebins+e1);
+   h->SetDirectory(0);
+   h->SetStats(0);
+   h->GetXaxis()->SetTitle("time [second]");
+   h->GetYaxis()->SetTitle("nuclear recoil energy [keV]");
+   Double_t scale = Scale();
+   for (Int_t ix=t1; ix<=t2; ix++)
+      for (Int_t iy=e1; iy<=e2; iy++)
+         h->SetBinContent(ix-t1+1, iy-e1+1, unit[ix*nbinse+iy]*scale);
+   return h;
+}
+
+//______________________________________________________________________________
+//
+
+SnapshotPtr SupernovaExperiment::TakeSnapshot(UShort_t type)
+{
+   if (type>6) {
+      Warning("TakeSnapshot","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      return SnapshotPtr();
+   }
+   if (!CanCalculate("TakeSnapshot")) return SnapshotPtr();
+
+   // also resets the snapshot if its results used other settings
+   CheckSettings(type);
+
+   const Snapshot *last = fSnapshot[type].get();
+   if (last && last->Distance()==Distance
+         && last->TargetMass()==fDetector->TargetMass
+         && last->Threshold()==fDetector->EnergyThreshold)
+      return fSnapshot[type];
+
+   // the detectable profile is replaced by the next call of HNevtT
+   TH1D *detectableT = (TH1D*) HNevtT(type, kTRUE)->Clone();
+   detectableT->SetDirectory(0);
+   TH2D *nevt2 = HNevt2(type);
+   fSnapshot[type] = SnapshotPtr(new Snapshot(
+            Form("snapshot-%d-%s", type, Source()->GetName()),
+            Source()->GetTitle(), type, Distance, fDetector->TargetMass,
+            fDetector->EnergyThreshold, HNevtE(type), HNevtT(type),
+            detectableT, nevt2, Nevaluations(nevt2)));
+   delete detectableT;
+   return fSnapshot[type];
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Refine(std::function<Double_t(Double_t)> f,
+      Double_t min, Double_t max, Double_t tolerance, Double_t minWidth,
+      std::vector<Double_t> &edges, std::vector<Double_t> &mean,
+      std::vector<Double_t> &error)
+{
+   const Int_t ninit=8; // coarse start, also to estimate the total
+   std::vector<Double_t> seeds(ninit+1);
+   for (Int_t i=0; i<=ninit; i++) seeds[i] = min+i*(max-min)/ninit;
+   Refine(f, seeds, tolerance, minWidth, edges, mean, error);
+}
+
+//______________________________________________________________________________
+//
+
+void SupernovaExperiment::Refine(std::function<Double_t(Double_t)> f,
+      const std::vector<Double_t> &seeds, Double_t tolerance,
+      Double_t minWidth, std::vector<Double_t> &edges,
+      std::vector<Double_t> &mean, std::vector<Double_t> &error)
+{
+   edges.clear();
+   mean.clear();
+   error.clear();
+   Int_t ninit = seeds.size()-1;
+   if (ninit<1) return;
+   Double_t min = seeds.front(), max = seeds.back(), total=0;
+
+   std::vector<Double_t> x(2*ninit+1), y(2*ninit+1);
+   for (Int_t i=0; i<ninit; i++) {
+      x[2*i] = seeds[i];
+      x[2*i+1] = (seeds[i]+seeds[i+1])/2;
+   }
+   x[2*ninit] = max;
+   for (Int_t i=0; i<=2*ninit; i++) y[i] = f(x[i]);
+   for (Int_t i=0; i<ninit; i++)
+      total += (x[2*i+2]-x[2*i])*(y[2*i]+4*y[2*i+1]+y[2*i+2])/6;
+   Double_t floor = tolerance*Abs(total)/(max-min);
+
+   // intervals with values at both ends and the middle, last one on top
+   struct Interval { Double_t a, b, fa, fm, fb; };
+   std::vector<Interval> stack;
+   for (Int_t i=ninit-1; i>=0; i--) {
+      Interval in = {x[2*i], x[2*i+2], y[2*i], y[2*i+1], y[2*i+2]};
+      stack.push_back(in);
+   }
+   while (!stack.empty()) {
+      Interval in = stack.back();
+      stack.pop_back();
+      Double_t h = in.b-in.a;
+      Double_t simpson = (in.fa+4*in.fm+in.fb)/6; // mean values
+      Double_t trapezoid = (in.fa+2*in.fm+in.fb)/4;
+      Double_t err = Abs(simpson-trapezoid);
+      if (err<=tolerance*Abs(simpson) || err<=floor || h/2<minWidth) {
+         edges.push_back(in.a);
+         mean.push_back(simpson);
+         error.push_back(err);
+         continue;
+      }
+      Double_t m = (in.a+in.b)/2;
+      Interval right = {m, in.b, in.fm, f((m+in.b)/2), in.fb};
+      Interval left = {in.a, m, in.fa, f((in.a+m)/2), in.fm};
+      stack.push_back(right);
+      stack.push_back(left);
+   }
+   edges.push_back(max);
+}
+
+//______________________________________________________________________________
+//
+
+TH1D* SupernovaExperiment::HNevtEAdaptive(UShort_t type, Double_t tolerance)
+{
+   if (type>6) {
+      Warning("HNevtEAdaptive","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevtEAdaptive","Return NULL pointer!");
+      return 0;
+   }
+   if (!CanCalculate("HNevtEAdaptive")) return 0;
+
+   Double_t ebins[200];
+   Double_t maxEr = ebins[RecoilBins(ebins)];
+   Double_t minEr = fDetector->EnergyThreshold/keV;
+   std::vector<Double_t> edges, mean, error;
+   Long64_t neval=0, nintegrals=0;
+   Refine([&](Double_t e) {
+         nintegrals++;
+         return UnitNevtE(type, e*keV, 0, &neval);
+         }, minEr, maxEr, tolerance, 0.01, edges, mean, error);
+
+   TH1D *h = new TH1D(Form("hNevtEAdaptive-%d-%f", type,
+            fDetector->EnergyThreshold),"",edges.size()-1,edges.data());
+   Double_t scale = Scale();
+   for (size_t i=0; i<mean.size(); i++) {
+      h->SetBinContent(i+1, mean[i]*scale);
+      h->SetBinError(i+1, error[i]*scale);
+   }
+   h->SetStats(0);
+   h->SetTitle(Form("%s",Source()->GetTitle()));
+   h->SetXTitle("true nuclear recoil energy [keV]");
+   h->SetYTitle(Form("number of events / (keV#times %.0f kg)",
+            fDetector->TargetMass/kg));
+   h->GetYaxis()->SetTitleOffset(1.3);
+   Record(h, neval, nintegrals);
+   return h;
+}
+
+//______________________________________________________________________________
+//
+
+TH2D* SupernovaExperiment::HNevt2Adaptive(UShort_t type, Double_t tolerance)
+{
+   if (type>6) {
+      Warning("HNevt2Adaptive","Type of neutrinos must be in 0, 1, 2, 3, 4, 5, 6!");
+      Warning("HNevt2Adaptive","Return NULL pointer!");
+      return 0;
+   }
+   if (!CanCalculate("HNevt2Adaptive")) return 0;
+
+   // values of UnitNevt2 are kept, refinements share many points
+   std::map<std::pair<Double_t,Double_t>, Double_t> value;
+   Long64_t neval=0, nintegrals=0;
+   auto f = [&](Double_t t, Double_t e) -> Double_t {
+      std::pair<Double_t,Double_t> key(t,e);
+      std::map<std::pair<Double_t,Double_t>, Double_t>::iterator it =
+         value.find(key);
+      if (it!=value.end()) return it->second;
+      nintegrals++;
+      return value[key] = UnitNevt2(type, t*sec, e*keV, 0, &neval);
+   };
+
+   // recoil energy bins from the time integrated spectrum
+   Double_t ebins[200];
+   Double_t maxEr = ebins[RecoilBins(ebins)];
+   Double_t minEr = fDetector->EnergyThreshold/keV;
+   std::vector<Double_t> eedges, tedges, mean, error;
+   Refine([&](Double_t e) {
+         nintegrals++;
+         return UnitNevtE(type, e*keV, 0, &neval);
+         }, minEr, maxEr, tolerance, 0.01, eedges, mean, error);
+
+   // time bins from the rate summed over recoil energy bins
+   Int_t nbinst;
+   const Double_t *tbins = TimeBins(nbinst);
+   Double_t tmin = tbins[0], tmax = tbins[nbinst];
+   // seeded with three steps per decade after the start of the model, from
+   // 1e-5 of its duration: fine enough to catch the early peak, coarse in
+   // the cooling phase, where the bins of the model would all be refined
+   std::vector<Double_t> tseeds(1, tmin);
+   for (Int_t k=-15; k<=0; k++)
+      tseeds.push_back(tmin+(tmax-tmin)*Power(10., k/3.));
+   Refine([&](Double_t t) {
+         Double_t rate=0;
+         for (size_t j=0; j+1<eedges.size(); j++)
+            rate += (f(t,eedges[j])+f(t,eedges[j+1]))/2
+               *(eedges[j+1]-eedges[j]);
+         return rate;
+         }, tseeds, tolerance, (tmax-tmin)*1e-5, tedges, mean, error);
+
+   Int_t nt = tedges.size()-1, ne = eedges.size()-1;
+   TH2D *h = new TH2D(Form("hNevt2Adaptive-%d-%f", type,
+            fDetector->EnergyThreshold),"",nt,tedges.data(),ne,eedges.data());
+
+   // corners are shared with the refinement of time bins, cell centers
+   // are new: (2*center+mean of corners)/3 as in Simpson's rule
+   Double_t scale = Scale();
+   for (Int_t ix=0; ix<nt; ix++) {
+      Double_t ta = tedges[ix], tb = tedges[ix+1];
+      for (Int_t iy=0; iy<ne; iy++) {
+         Double_t ea = eedges[iy], eb = eedges[iy+1];
+         Double_t center = f((ta+tb)/2,(ea+eb)/2);
+         Double_t corners = (f(ta,ea)+f(ta,eb)+f(tb,ea)+f(tb,eb))/4;
+         h->SetBinContent(ix+1, iy+1, (2*center+corners)/3*scale);
+         h->SetBinError(ix+1, iy+1, Abs(center-corners)/3*scale);
+      }
+   }
+   h->SetStats(0);
+   h->SetTitle(Form("%s",Source()->GetTitle()));
+   h->SetXTitle("time [second]");
+   h->SetYTitle("true nuclear recoil energy [keV]");
+   h->GetYaxis()->SetTitleOffset(1.3);
+   Record(h, neval, nintegrals);
+   return h;
 }
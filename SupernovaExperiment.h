@@ -2,63 +2,496 @@
 #define CNNS_SUPERNOVAEXPERIMENT_H
 
 #include <TNamed.h>
+
+#include <map>
+#include <vector>
+#include <functional>
+
+#include "FluxMoments.h"
+#include "Stats.h"
+#include "ResultCache.h"
+#include "Snapshot.h"
+
 class TF1;
+class TH1;
+class TAxis;
 class TH1D;
 class TH2D;
 
 namespace NEUS { class SupernovaModel; }
+namespace MAD { class Element; }
 
 namespace CNNS {
    class SupernovaExperiment;
    class Detector;
+   class XSTable;
+   class ResponseMatrix;
+   class FluxTable;
 }
 
 class CNNS::SupernovaExperiment : public TNamed
 {
    public:
+      /**
+       * Methods to integrate over neutrino energies.
+       */
+      enum EIntegration {
+         kAdaptive, // TF1::Integral of dXS*Ne or dXS*N2
+         kTabulated, // trapezoidal rule using tabulated dXS(Er, Ev)
+         kMoments, // dXS as a0+a1/Ev+a2/Ev^2 folded with flux moments
+         kResponse, // ResponseMatrix times tabulated flux
+         kGaussLegendre, // GaussLegendreOrder points on dXS*Ne or dXS*N2
+         kGaussKronrod, // adaptive 7-15 points Gauss-Kronrod within Tolerance
+      };
+
       Double_t Distance; // distance between detector and Supernova
+      UInt_t Nthreads; // number of threads used to fill histograms
+      EIntegration Integration; // method to integrate over neutrino energy
+      Int_t GaussLegendreOrder; // number of points of kGaussLegendre
+      Double_t Tolerance; // relative tolerance of kGaussKronrod
+      /**
+       * ROOT file to keep HNevtE and HNevt2 between jobs. Results are
+       * stored per kg at 1 kpc without threshold, keyed by a hash of the
+       * supernova model (name, time bins and fluxes sampled on a grid),
+       * the target, the binning, the integration method and fgXSVersion.
+       * Nothing is cached if it is empty (default). Each read or write
+       * holds an advisory lock on CacheFile.lock, so that processes on one
+       * host can share a file. flock may not work across hosts on network
+       * file systems: parallel jobs there should each use their own file
+       * and merge them with hadd afterwards.
+       */
+      TString CacheFile;
+      /**
+       * Version of the calculation of dXS and its integrals, increase it
+       * when they change to invalidate old cache files.
+       */
+      static const Int_t fgXSVersion=2;
 
    protected:
       Detector* fDetector;
       NEUS::SupernovaModel *fModel; // supernova model
+      FluxTable *fFlux; //! fluxes used instead of those of fModel if set
 
       TF1 *fFXSxN2[7]; // dXS(Ev) * N2(time,Ev)
       TF1 *fFXSxNe[7]; // dXS(Ev) * Ne(Ev)
       TH2D *fHNevt2[7]; // Nevt(t, Enr)
       TH1D *fHNevtT[7]; // Nevt(t)
       TH1D *fHNevtE[7]; // Nevt(Enr)
+      TH2D *fHUnit2[7]; // Nevt(t, Enr) per kg at 1 kpc without threshold
+      TH1D *fHUnitE[7]; // Nevt(Enr) per kg at 1 kpc without threshold
+      Double_t fScale2[7]; // scale applied to fHNevt2
+      Double_t fScaleT[7]; // scale applied to fHNevtT
+      Double_t fScaleE[7]; // scale applied to fHNevtE
+      Double_t fThreshold2[7]; // threshold applied to fHNevt2
+      Double_t fThresholdE[7]; // threshold applied to fHNevtE
+      std::vector<Double_t> fCumE[7]; //! sum of fHUnitE*width up to a bin
+      std::vector<Double_t> fCum2[7]; //! the same in each time bin
+      std::vector<Double_t> fCumEff2[7]; //! fCum2 weighted by efficiency
+      std::vector<Double_t> fErr2[7]; //! the same for integration errors
+      std::vector<Double_t> fLazy2[7]; //! bins of fHUnit2 needed so far
+      TString fUnitSettings[7]; //! IntegrationSettings of fHUnit*, fLazy2
+
+      Double_t fFlavorWeight[7]; // weights of flavors in type 0
+
+      XSTable *fXSTable; // dXS(Er, Ev) per target nucleus on recoil bins
+      std::vector<TString> fXSElements; //! ElementKey of its elements
+      std::vector<Double_t> fAbundance; //! Abundance of each element
+      std::map<TString, XSTable*> fKernels; //! dXS by ElementKey
+      ResponseMatrix *fResponse; // fXSTable times integration weights
+      ResultCache *fResults; //! unit histograms in memory by CacheKey
+      SnapshotPtr fSnapshot[7]; //! last snapshots, shared with callers
+      std::vector<Double_t> fFluxNe[7]; //! Ne on neutrino energy grid
+      std::vector<Double_t> fFluxN2[7]; //! N2 on neutrino energy grid
+      Double_t fFluxTime[7]; //! time of fFluxN2
+      FluxMoments fMomentsNe[7]; //! cumulative moments of Ne
+      std::map<Double_t, FluxMoments> fMomentsN2[7]; //! moments of N2
+      struct FillRecord {
+         Long64_t Nevaluations; // integrand evaluations
+         Long64_t Nintegrals; // integrals done by Fill
+         Double_t FillTime; // second taken by Fill
+      };
+      std::map<TString, FillRecord> fRecords; //! by histogram name, CacheKey
 
       Double_t XSxNe(Double_t *x, Double_t *parameter); // function of dXS * Ne
       Double_t XSxN2(Double_t *x, Double_t *parameter); // function of dXS * N2
 
+      Double_t Ne(UShort_t type, Double_t Ev) const; // weighted sum for type 0
+      Double_t N2(UShort_t type, Double_t time, Double_t Ev) const;
+
+      Double_t EMin() const; // lowest neutrino energy of fFlux or fModel [MeV]
+      Double_t EMax() const; // highest neutrino energy of fFlux or fModel [MeV]
+      const Double_t* TimeBins(Int_t &n); // n time bins of fFlux or fModel
+      const TNamed* Source(); // fFlux or fModel, for names and titles
+
+      Bool_t CanEvaluate(const char *method) const; // inputs are set
+      Bool_t CanCalculate(const char *method); // and fAbundance is ready
+      Int_t RecoilBins(Double_t *ebins); // default nuclear recoil bins
+      Double_t Normalization() const; // number of nuclei per kg / area at 1 kpc
+      /**
+       * Make sure that cells (ix-1)*nbinse+iy-1 of fLazy2[type] are
+       * calculated, integrating only those that are not yet, and return
+       * fLazy2[type]. Cells of unknown value are NaN. The whole unit map
+       * is used if it is found by CacheKey, and integrated cells are kept
+       * by CacheKey as well, in a map named hLazyNevt2.
+       */
+      const Double_t* LazyUnit2(UShort_t type, const std::vector<Int_t> &cells);
+      /**
+       * Fraction of target nuclei of element i, Natoms(i)/sum of Natoms.
+       */
+      Double_t Abundance(UShort_t i) const;
+      /**
+       * Name, A and M of element, which identify it also after the detector
+       * it belongs to is cloned or deleted, unlike its address.
+       */
+      static TString ElementKey(MAD::Element *element);
+      /**
+       * dXS(Er, Ev) per target nucleus, summed over elements weighted by
+       * their abundances, each above its kinematic threshold.
+       */
+      Double_t TargetdXS(Double_t Er, Double_t Ev) const;
+      /**
+       * Minimal neutrino energy to give Enr to the lightest target nucleus.
+       */
+      Double_t DetectableEv(Double_t Enr) const;
+      std::vector<Double_t> fGLx[2]; //! Gauss-Legendre points, n and n/2
+      std::vector<Double_t> fGLw[2]; //! Gauss-Legendre weights, n and n/2
+
+      /**
+       * Functions below that integrate over neutrino energies add an
+       * estimate of the integration error to *error and the number of
+       * integrand evaluations to *neval if they are given.
+       */
+      Double_t UnitNevtE(UShort_t type, Double_t Enr, Double_t *error=0,
+            Long64_t *neval=0); // NevtE per kg at 1 kpc
+      Double_t UnitNevt2(UShort_t type, Double_t time, Double_t Enr,
+            Double_t *error=0, Long64_t *neval=0);
+      Double_t IntegrateNe(TF1 *f, Double_t Enr, Double_t *error=0,
+            Long64_t *neval=0); // integral of f=dXS*Ne
+      Double_t IntegrateN2(TF1 *f, Double_t time, Double_t Enr,
+            Double_t *error=0, Long64_t *neval=0);
+      /**
+       * Integral of f from a to b with kAdaptive, kGaussLegendre or
+       * kGaussKronrod. The error of kGaussLegendre is the difference to
+       * half the number of points, an upper estimate.
+       */
+      Double_t Quadrature(TF1 *f, Double_t a, Double_t b, Double_t *error,
+            Long64_t *neval) const;
+      void GaussLegendreNodes(); // fill fGLx and fGLw if order changed
+      /**
+       * Fill Gauss-Legendre points and weights of GaussLegendreOrder in
+       * x[0], w[0] and of half of it in x[1], w[1] if their sizes differ.
+       */
+      void LegendreNodes(std::vector<Double_t> *x,
+            std::vector<Double_t> *w) const;
+      Int_t LegendreOrder(Int_t k) const; // of x[k] in LegendreNodes
+      /**
+       * Unit NevtE (time=NULL) or Nevt2 integrated with a TF1 of this call,
+       * without any table of this experiment.
+       */
+      Double_t EvaluateUnit(UShort_t type, const Double_t *time, Double_t Enr,
+            Long64_t *neval=0) const;
+      /**
+       * Evaluate Ne (time=NULL) or N2 at n neutrino energies.
+       */
+      void TabulateFlux(UShort_t type, const Double_t *time, Int_t n,
+            const Double_t *Ev, Double_t *flux);
+      const Double_t* FluxNe(UShort_t type); // Ne on grid of fXSTable
+      const Double_t* FluxN2(UShort_t type, Double_t time);
+      Double_t TabulateNe(UShort_t type, Double_t Enr, Double_t *error=0,
+            Long64_t *neval=0); // NevtE by fXSTable
+      Double_t TabulateN2(UShort_t type, Double_t time, Double_t Enr,
+            Double_t *error=0, Long64_t *neval=0);
+      /**
+       * Coefficients of dXS(Enr, Ev) of element = a[0] + a[1]/Ev + a[2]/Ev^2
+       * from a quadratic interpolation in 1/Ev between minEv and maxEv.
+       */
+      void XSCoefficients(MAD::Element *element, Double_t Enr,
+            Double_t minEv, Double_t maxEv, Double_t *a);
+      FluxMoments* MomentsNe(UShort_t type);
+      FluxMoments* MomentsN2(UShort_t type, Double_t time);
+      /**
+       * dXS folded with the flux of moments, summed over elements with
+       * their abundances, each fitted and integrated above its own
+       * kinematic threshold, as the sum is not smooth at the thresholds.
+       */
+      Double_t MomentIntegral(const FluxMoments *moments, Double_t Enr);
+      Double_t MomentNe(UShort_t type, Double_t Enr); // NevtE by moments
+      Double_t MomentN2(UShort_t type, Double_t time, Double_t Enr);
+      Double_t ResponseNe(UShort_t type, Double_t Enr); // NevtE by fResponse
+      Double_t ResponseN2(UShort_t type, Double_t time, Double_t Enr);
+      /**
+       * Fill nevt[i] with UnitNevt2(type,time[i],Enr[i]), or with
+       * UnitNevtE(type,Enr[i]) if time is NULL, using Nthreads threads.
+       * Each thread integrates its own copy of the integrand, so the result
+       * is identical to a serial loop over UnitNevtE or UnitNevt2. Errors
+       * and evaluations of each point go to error and neval if given.
+       */
+      void Integrate(UShort_t type, Int_t n, const Double_t *time,
+            const Double_t *Enr, Double_t *nevt, Double_t *error=0,
+            Long64_t *neval=0);
+      /**
+       * Fill all bins of h with UnitNevt2 or UnitNevtE, integration
+       * errors as bin errors and evaluations with Record.
+       */
+      void Fill(UShort_t type, TH2D *h);
+      void Fill(UShort_t type, TH1D *h);
+      /**
+       * Fill h with the weighted sum of UnitHNevt2 or UnitHNevtE of type
+       * 1-6, which are calculated if they are not cached yet.
+       */
+      void Combine(TH2D *h);
+      void Combine(TH1D *h, Bool_t refresh);
+      /**
+       * h=unit*scale in bins with recoil energies above minEr, 0 below.
+       */
+      void Rescale(TH2D *h, const TH2D *unit, Double_t scale, Double_t minEr);
+      void Rescale(TH1D *h, const TH1D *unit, Double_t scale, Double_t minEr);
+      Int_t FirstBinAbove(TAxis *axis, Double_t minEr); // by bin center
+      /**
+       * Cumulative sums of UnitHNevt2*efficiency over recoil energies.
+       */
+      const std::vector<Double_t>& DetectableCumulative(UShort_t type);
+
+      /**
+       * HNevt2 and HNevtE per kg at 1 kpc without threshold. Cumulative
+       * sums over recoil energies are prepared at the same time.
+       */
+      TH2D* UnitHNevt2(UShort_t type);
+      TH1D* UnitHNevtE(UShort_t type, Bool_t refresh=kFALSE);
+      /**
+       * Bins of f in [min, max] split in halves until Simpson's rule and
+       * the trapezoidal rule agree within tolerance, relative to the bin or
+       * to the average over [min, max] in a bin of the same width. Mean of
+       * f in each bin and its error are returned with the bin edges.
+       */
+      void Refine(std::function<Double_t(Double_t)> f, Double_t min,
+            Double_t max, Double_t tolerance, Double_t minWidth,
+            std::vector<Double_t> &edges, std::vector<Double_t> &mean,
+            std::vector<Double_t> &error);
+      /**
+       * Refine starting from the intervals between seeds instead of eight
+       * equal intervals, so that structure narrower than (max-min)/8, e.g.
+       * the first 50 ms of a supernova, can not be missed.
+       */
+      void Refine(std::function<Double_t(Double_t)> f,
+            const std::vector<Double_t> &seeds, Double_t tolerance,
+            Double_t minWidth, std::vector<Double_t> &edges,
+            std::vector<Double_t> &mean, std::vector<Double_t> &error);
+      /**
+       * Keep the number of integrand evaluations spent on h, and the number
+       * of integrals and the seconds taken by Fill, in fRecords by the name
+       * of h. Copies in Results() have theirs by CacheKey, and CacheFile
+       * keeps them next to each histogram, so h itself is left untouched.
+       */
+      void Record(TH1 *h, Long64_t neval, Long64_t nintegrals=0,
+            Double_t filltime=0);
+      void Record(TH1 *h, const char *from); // the record kept by name from
+      void Record(TH1 *h, const TH1 *from); // the record of from
+      FillRecord RecordOf(const TH1 *h) const; // zeros if none is kept
+      void CopyResult(const TH1 *from, TH1 *to); // with errors, record
+      TString CacheKey(UShort_t type, TH1 *h); // name + hash of inputs
+      /**
+       * Integration, GaussLegendreOrder or Tolerance if it is used, and
+       * fgXSVersion, which are part of CacheKey.
+       */
+      TString IntegrationSettings();
+      /**
+       * ClearType(type) if its unit results were integrated with other
+       * IntegrationSettings, as they are public and can change any time.
+       */
+      void CheckSettings(UShort_t type);
+      /**
+       * Copy from Results(), or else from CacheFile into Results().
+       */
+      Bool_t ReadCache(const char *key, TH1 *h);
+      void WriteCache(const char *key, TH1 *h); // to Results() and CacheFile
+
    public:
       SupernovaExperiment(Detector *detector=0, NEUS::SupernovaModel *model=0);
-      virtual ~SupernovaExperiment() { Clear(); } 
+      virtual ~SupernovaExperiment();
 
-      void SetDetector(Detector *detector) { Clear(); fDetector = detector; }
+      /**
+       * Results per kg at 1 kpc are kept if the new detector has the same
+       * target, i.e. the same material, elements and abundances, even in
+       * other objects. Otherwise they are kept in Results().
+       */
+      void SetDetector(Detector *detector);
+      /**
+       * Return kTRUE if detector has the same target as the current one.
+       */
+      Bool_t SameTarget(const Detector *detector);
+      /**
+       * Snapshots of a type for each of detectors at the current Distance,
+       * in the order of detectors. Detectors are taken in groups of the
+       * same target: integrals are done once per group, each detector in
+       * it only costs scaling, a threshold cut and folding with its
+       * efficiency. Each other target costs the integrals of its unit
+       * results, unless they are found in Results() or CacheFile. The
+       * current detector is set back afterwards.
+       */
+      std::vector<SnapshotPtr> Evaluate(UShort_t type,
+            const std::vector<Detector*> &detectors);
 
       void SetSupernovaModel(NEUS::SupernovaModel *model)
-      { Clear(); fModel = model; }
+      { Clear(); fModel = model; fFlux = 0; }
       NEUS::SupernovaModel* Model() { return fModel; }
+      /**
+       * Take fluxes from a table written by FluxTable::Convert instead of a
+       * supernova model, which then needs not be loaded. The table is not
+       * owned. SetSupernovaModel switches back to a model.
+       */
+      void SetFluxTable(FluxTable *table) { Clear(); fFlux = table; }
+      FluxTable* Flux() { return fFlux; }
+
+      /**
+       * Set the weight of neutrino type 1-6 in type 0, which is the sum of
+       * all flavors. Default weights are 1, 1, 4 for type 1, 2, 3, 0 for
+       * the others. Only results of type 0 are recalculated, from the
+       * cached results of the other types.
+       */
+      void SetFlavorWeight(UShort_t type, Double_t weight);
+      Double_t FlavorWeight(UShort_t type) { return fFlavorWeight[type]; }
 
       TF1* FXSxNe(UShort_t type, Double_t Enr);
       TH1D* HXSxNe(UShort_t type, Double_t Enr);
       Double_t NevtE(UShort_t type, Double_t Enr);
+      /**
+       * NevtE and Nevt2 integrated with an integrand of their own, without
+       * tables, functions or histograms of this experiment, so that several
+       * threads can call them at the same time while no non-const method
+       * runs. kAdaptive, kGaussLegendre and kGaussKronrod are used as set,
+       * the other methods, which need shared tables, fall back to kAdaptive.
+       * A TF1 is created per call, so call ROOT::EnableThreadSafety() first.
+       */
+      Double_t EvaluateNevtE(UShort_t type, Double_t Enr) const;
+      Double_t EvaluateNevt2(UShort_t type, Double_t time, Double_t Enr) const;
       TH1D* HNevtE(UShort_t type, Bool_t refresh=kFALSE); // Nevt(Enr)
 
-      Double_t Nevt(); // total number of events
+      Double_t Nevt(); // total number of events above threshold
+      /**
+       * Number of events of a type above minEr from cached cumulative
+       * sums, it costs a binary search per call.
+       */
+      Double_t Nevt(UShort_t type, Double_t minEr);
+
+      /**
+       * Results are calculated per kg of target at 1 kpc and multiplied
+       * by this factor, (TargetMass/kg)*(kpc/Distance)^2, when they are
+       * read. Changing Distance or TargetMass needs no new integrals.
+       */
+      Double_t Scale() const;
+
+      /**
+       * Number of integrand evaluations spent to calculate h, including
+       * flavors summed up in type 0 and results read from CacheFile.
+       * Integration errors are stored as bin errors of h. They are not
+       * estimated for kMoments and kResponse. Records are kept by the name
+       * of h for histograms of this experiment, 0 is returned for others.
+       */
+      Long64_t Nevaluations(const TH1 *h) const;
+      /**
+       * Number of integrals over neutrino energy and seconds spent by Fill
+       * on h, summed in the same way as Nevaluations.
+       */
+      Long64_t Nintegrals(const TH1 *h) const;
+      Double_t FillTime(const TH1 *h) const;
+      /**
+       * Integrand evaluations of the calling thread so far. The difference
+       * around a call counts its evaluations, unless it fills histograms
+       * with Nthreads>1, whose evaluations are in Nevaluations instead.
+       */
+      static Long64_t ThreadEvaluations();
+
+      /**
+       * Counters of fluxes, integrals, fills and caches of all
+       * experiments in threads that have ended and in the calling one.
+       * Use DumpStatsAtExit or CNNS_STATS_JSON to save them as JSON.
+       */
+      static Stats Statistics() { return GlobalStats(); }
+      static void ResetStatistics() { ResetStats(); }
+
+      /**
+       * Unit histograms of recent models, targets and integrations, the
+       * least recently used ones are dropped above ResultCache::Budget().
+       * Switching back to a model or detector takes them from here instead
+       * of calculating them again.
+       */
+      ResultCache* Results() { return fResults; }
 
       TF1* FXSxN2(UShort_t type, Double_t time, Double_t Enr);
       Double_t Nevt2(UShort_t type, Double_t time, Double_t Enr);
       TH2D* HNevt2(UShort_t type); // Nevt(t, Enr)
+      /**
+       * Number of events between tmin and tmax with recoil energies between
+       * minEr and maxEr, taking fractions of partially covered bins of
+       * HNevt2. Only bins in the window are integrated, once, unless the
+       * whole map is already calculated. The threshold is not applied.
+       */
+      Double_t Nevt(UShort_t type, Double_t tmin, Double_t tmax,
+            Double_t minEr, Double_t maxEr);
+      /**
+       * Bins of HNevt2 overlapping the window, calculated the same lazy way
+       * as Nevt(type, tmin, tmax, minEr, maxEr). Caller owns it.
+       */
+      TH2D* HNevt2(UShort_t type, Double_t tmin, Double_t tmax,
+            Double_t minEr, Double_t maxEr);
       TH1D* HNevtT(UShort_t type, Bool_t detectableOnly=kFALSE); // Nevt(t)
 
       /**
-       * Delete internal objects.
+       * Results of a type at the current distance and threshold frozen in
+       * an immutable object, which can be read from several threads and
+       * stays valid after setters or Clear() of this experiment. The same
+       * snapshot is returned until distance, target mass or threshold
+       * change or Clear() is called, or the results of the type are
+       * dropped by CheckSettings. Taking a snapshot is not reentrant.
+       */
+      SnapshotPtr TakeSnapshot(UShort_t type);
+
+      /**
+       * HNevtE and HNevt2 above threshold on bins refined only where the
+       * number of events changes quickly, within a relative tolerance.
+       * Bin errors are estimates of integration errors. Time bins are
+       * refined from three per decade after the start of the model. The
+       * integrals spent are recorded in Nintegrals. Histograms are not
+       * cached and are owned by the caller.
+       */
+      TH1D* HNevtEAdaptive(UShort_t type, Double_t tolerance=1e-3);
+      TH2D* HNevt2Adaptive(UShort_t type, Double_t tolerance=1e-3);
+
+      /**
+       * dXS(Er, Ev) per target nucleus tabulated on the default recoil bins,
+       * the sum of the tables of all target elements weighted by their
+       * abundances. Tables of elements are kept when the supernova model or
+       * the detector is changed, so a new composition only needs tables of
+       * new elements.
+       */
+      XSTable* CrossSectionTable();
+      /**
+       * Response of the target on the default recoil bins, built from
+       * CrossSectionTable(). Multiplying it with a flux tabulated on
+       * CrossSectionTable()->Ev() and with Normalization() gives Nevt(Enr).
+       */
+      ResponseMatrix* Response();
+
+      /**
+       * Compare NevtE(type) calculated with kMoments to that of kAdaptive
+       * in all recoil bins above threshold. Return the largest relative
+       * difference. Differences larger than tolerance are printed.
+       */
+      Double_t ValidateMoments(UShort_t type, Double_t tolerance=1e-2);
+
+      /**
+       * Delete internal objects that depend on the supernova model.
        */
       void Clear(Option_t *option="");
+      void ClearType(UShort_t type); // delete objects of one type
+      /**
+       * Delete objects of one type that depend on the detector but not on
+       * its target: scaled histograms, functions and efficiency sums.
+       */
+      void ClearViews(UShort_t type);
 
-      ClassDef(SupernovaExperiment,1);
+      ClassDef(SupernovaExperiment,7);
 };
 
 #endif
@@ -3,6 +3,8 @@ using namespace CNNS;
 
 #include <TH1D.h>
 
+#include <algorithm>
+
 #include <MAD/NaturalXe.h>
 #include <MAD/LiquidXenon.h>
 using namespace MAD;
@@ -97,3 +99,19 @@ Double_t XMASS835kg::Efficiency(Double_t Enr)
 {
    return HEff()->Interpolate(Enr/keV);
 }
+
+//______________________________________________________________________________
+//
+
+void XMASS835kg::Efficiencies(Int_t n, const Double_t *Enr,
+      Double_t *efficiency)
+{
+   Bool_t resample = fEnr.size()!=static_cast<size_t>(n);
+   for (Int_t i=0; i<n && !resample; i++) resample = fEnr[i]!=Enr[i];
+   if (resample) {
+      fEnr.assign(Enr, Enr+n);
+      fEff.resize(n);
+      for (Int_t i=0; i<n; i++) fEff[i] = HEff()->Interpolate(Enr[i]/keV);
+   }
+   std::copy(fEff.begin(), fEff.end(), efficiency);
+}
@@ -3,6 +3,8 @@
 
 #include "LXeDetector.h"
 
+#include <vector>
+
 class TH1D;
 
 namespace CNNS { class XMASS835kg; }
@@ -11,6 +13,8 @@ class CNNS::XMASS835kg : public CNNS::LXeDetector
 {
    private:
       TH1D *fHEff;
+      std::vector<Double_t> fEnr; //! energies of resampled efficiencies
+      std::vector<Double_t> fEff; //! efficiencies resampled at fEnr
 
    public:
       XMASS835kg(const char *name="XMASS835kg",
@@ -19,6 +23,12 @@ class CNNS::XMASS835kg : public CNNS::LXeDetector
 
       TH1D* HEff();
       Double_t Efficiency(Double_t Enr);
+      /**
+       * Efficiencies interpolated at Enr are kept, so that repeated calls
+       * with the same energies, such as bin centers of a spectrum, only
+       * copy them.
+       */
+      void Efficiencies(Int_t n, const Double_t *Enr, Double_t *efficiency);
 
       ClassDef(XMASS835kg,1);
 };
@@ -0,0 +1,149 @@
+#include "Detector.h"
+#include "XSTable.h"
+using namespace CNNS;
+
+#include <MAD/Element.h>
+using namespace MAD;
+
+#include <TMath.h>
+using namespace TMath;
+
+#include <algorithm>
+
+ClassImp(XSTable)
+
+//______________________________________________________________________________
+//
+
+XSTable::XSTable(MAD::Element *element, Int_t nEr, const Double_t *Er,
+      Double_t maxEv, Int_t nEv) : TNamed(Form("XSTable%s",
+            element->GetName()), element->GetTitle()),
+   fElement(element), fMinEv(0), fMaxEv(maxEv)
+{
+   fElements.push_back(element);
+   fWeights.push_back(1);
+   fEv.resize(nEv+1);
+   for (Int_t i=0; i<=nEv; i++) fEv[i] = fMinEv + (fMaxEv-fMinEv)*i/nEv;
+
+   fEr.assign(Er, Er+nEr);
+   fdXS.resize(fEr.size()*fEv.size());
+   for (Int_t i=0; i<nEr; i++) FillRow(fEr[i], &fdXS[i*NEv()]);
+}
+
+//______________________________________________________________________________
+//
+
+Int_t XSTable::FindEr(Double_t Er) const
+{
+   std::vector<Double_t>::const_iterator it =
+      std::lower_bound(fEr.begin(), fEr.end(), Er*(1-1e-9));
+   if (it==fEr.end() || Abs(*it-Er)>1e-9*Abs(Er)) return -1;
+   return it-fEr.begin();
+}
+
+//______________________________________________________________________________
+//
+
+void XSTable::Add(const XSTable *table, Double_t weight)
+{
+   if (fEr.empty()) {
+      SetNameTitle(table->GetName(), table->GetTitle());
+      fElement = table->Element();
+      fMinEv = table->fMinEv;
+      fMaxEv = table->fMaxEv;
+      fEv = table->fEv;
+      fEr = table->fEr;
+      fdXS.assign(table->fdXS.size(), 0);
+   } else {
+      if (table->NEv()!=NEv() || table->NEr()!=NEr()
+            || table->MaxEv()!=fMaxEv) {
+         Warning("Add", "Tables are on different grids, %s is not added!",
+               table->GetName());
+         return;
+      }
+      SetName(Form("%s+%s", GetName(), table->GetName()));
+   }
+
+   for (size_t i=0; i<fdXS.size(); i++) fdXS[i] += weight*table->fdXS[i];
+   for (Int_t i=0; i<table->Nelements(); i++) {
+      fElements.push_back(table->Element(i));
+      fWeights.push_back(weight*table->Weight(i));
+   }
+}
+
+//______________________________________________________________________________
+//
+
+void XSTable::SetElement(Int_t i, MAD::Element *element)
+{
+   fElements[i] = element;
+   if (i==0) fElement = element;
+}
+
+//______________________________________________________________________________
+//
+
+void XSTable::FillRow(Double_t Er, Double_t *row) const
+{
+   for (Int_t i=0; i<NEv(); i++) row[i]=0;
+   for (Int_t k=0; k<Nelements(); k++) {
+      Double_t minEv = (Er + Sqrt(2*fElements[k]->M()*Er))/2;
+      for (Int_t i=0; i<NEv(); i++)
+         if (fEv[i]>=minEv)
+            row[i] += fWeights[k]*fElements[k]->CNNSdXS(Er, fEv[i]);
+   }
+}
+
+//______________________________________________________________________________
+//
+
+Double_t XSTable::Integral(const Double_t *row, const Double_t *flux,
+      Double_t minEv, Double_t maxEv, Int_t stride) const
+{
+   if (minEv<fMinEv) minEv=fMinEv;
+   if (maxEv>fMaxEv) maxEv=fMaxEv;
+   if (minEv>=maxEv) return 0;
+   if (stride<1) stride=1;
+
+   // intervals between grid points i*stride and (i+1)*stride
+   Int_t nint = (NEv()-1)/stride;
+   Double_t dEv = (fMaxEv-fMinEv)/(NEv()-1)*stride;
+   Int_t first = static_cast<Int_t>((minEv-fMinEv)/dEv);
+   Int_t last = static_cast<Int_t>((maxEv-fMinEv)/dEv);
+   if (last>nint-1) last=nint-1;
+
+   // trapezoid between grid points j1 and j2 clipped to [minEv, maxEv],
+   // with the linearly interpolated integrand at the clipped ends
+   auto trapezoid = [&](Int_t j1, Int_t j2) -> Double_t {
+      Double_t x1 = fEv[j1]>minEv?fEv[j1]:minEv;
+      Double_t x2 = fEv[j2]<maxEv?fEv[j2]:maxEv;
+      if (x2<=x1) return 0;
+      Double_t y1 = row[j1]*flux[j1], y2 = row[j2]*flux[j2];
+      Double_t width = fEv[j2]-fEv[j1];
+      Double_t a = y1 + (y2-y1)*(x1-fEv[j1])/width;
+      Double_t b = y1 + (y2-y1)*(x2-fEv[j1])/width;
+      return (a+b)/2*(x2-x1);
+   };
+
+   Double_t sum=0;
+   for (Int_t i=first; i<=last; i++)
+      sum += trapezoid(i*stride, (i+1)*stride);
+   // fine intervals left over if stride does not divide NEv()-1
+   for (Int_t j=nint*stride; j<NEv()-1; j++) sum += trapezoid(j, j+1);
+   return sum;
+}
+
+//______________________________________________________________________________
+//
+
+Int_t XSTable::Npoints(Double_t minEv, Double_t maxEv) const
+{
+   if (minEv<fMinEv) minEv=fMinEv;
+   if (maxEv>fMaxEv) maxEv=fMaxEv;
+   if (minEv>=maxEv) return 0;
+   Double_t dEv = (fMaxEv-fMinEv)/(NEv()-1);
+   Int_t first = static_cast<Int_t>((minEv-fMinEv)/dEv);
+   Int_t last = static_cast<Int_t>((maxEv-fMinEv)/dEv);
+   if (last>NEv()-2) last=NEv()-2;
+   return last-first+2;
+}
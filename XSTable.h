@@ -0,0 +1,88 @@
+#ifndef CNNS_XSTABLE_H
+#define CNNS_XSTABLE_H
+
+#include <TNamed.h>
+
+#include <vector>
+
+namespace MAD { class Element; }
+namespace CNNS { class XSTable; }
+
+/**
+ * Differential cross section dXS(Er, Ev) of a target element tabulated on
+ * a list of nuclear recoil energies Er and a uniform grid of neutrino
+ * energies Ev. It depends neither on the supernova model nor on the type of
+ * neutrinos, so it can be reused for all of them. Tables of several elements
+ * on the same grid can be added up with their abundances to get dXS per
+ * nucleus of a compound or a mixture of isotopes.
+ */
+class CNNS::XSTable : public TNamed
+{
+   protected:
+      MAD::Element *fElement; // first target element, not owned
+      std::vector<MAD::Element*> fElements; // all target elements
+      std::vector<Double_t> fWeights; // their abundances
+      Double_t fMinEv; // lower edge of the neutrino energy grid
+      Double_t fMaxEv; // upper edge of the neutrino energy grid
+      std::vector<Double_t> fEv; // neutrino energies
+      std::vector<Double_t> fEr; // nuclear recoil energies
+      std::vector<Double_t> fdXS; // dXS[iEr*NEv()+iEv]
+
+   public:
+      XSTable() : TNamed(), fElement(0), fMinEv(0), fMaxEv(0) {};
+      XSTable(MAD::Element *element, Int_t nEr, const Double_t *Er,
+            Double_t maxEv, Int_t nEv=1000);
+      virtual ~XSTable() {};
+
+      MAD::Element* Element() const { return fElement; }
+      Int_t Nelements() const { return fElements.size(); }
+      MAD::Element* Element(Int_t i) const { return fElements[i]; }
+      Double_t Weight(Int_t i) const { return fWeights[i]; }
+      /**
+       * Replace element i by an identical one, e.g. of a cloned detector,
+       * before the old one is deleted. Only FillRow uses it afterwards.
+       */
+      void SetElement(Int_t i, MAD::Element *element);
+      /**
+       * Add weight times dXS of table, which must be on the same grid
+       * unless this one is still empty.
+       */
+      void Add(const XSTable *table, Double_t weight=1);
+      Int_t NEr() const { return fEr.size(); }
+      Int_t NEv() const { return fEv.size(); }
+      Double_t MaxEv() const { return fMaxEv; }
+      const Double_t* Ev() const { return fEv.data(); }
+      const Double_t* Er() const { return fEr.data(); }
+      /**
+       * Row of dXS at fixed recoil energy Er[iEr].
+       */
+      const Double_t* Row(Int_t iEr) const { return &fdXS[iEr*NEv()]; }
+      /**
+       * Index of Er in the table, -1 if it is not tabulated.
+       */
+      Int_t FindEr(Double_t Er) const;
+      /**
+       * Calculate dXS at all neutrino energies for recoil energy Er, summed
+       * over elements with their weights. Kinematically forbidden entries
+       * are set to zero.
+       */
+      void FillRow(Double_t Er, Double_t *row) const;
+      /**
+       * Trapezoidal integral of row[i]*flux[i] over neutrino energies
+       * between minEv and maxEv. Partial intervals at the edges are
+       * integrated with the linearly interpolated integrand. Only every
+       * stride-th grid point is used if stride>1, e.g. to estimate the
+       * error of the full grid. Fine intervals left over at the top, if
+       * stride does not divide NEv()-1, are added with stride 1.
+       */
+      Double_t Integral(const Double_t *row, const Double_t *flux,
+            Double_t minEv, Double_t maxEv, Int_t stride=1) const;
+      /**
+       * Number of grid points used by Integral between minEv and maxEv.
+       */
+      Int_t Npoints(Double_t minEv, Double_t maxEv) const;
+
+      ClassDef(XSTable,2);
+};
+
+#endif